@@ -58,6 +58,15 @@ struct _NautilusInfoProviderIface {
 						     NautilusOperationHandle **handle);
 	void                    (*cancel_update)    (NautilusInfoProvider     *provider,
 						     NautilusOperationHandle  *handle);
+
+	/* Optional.  Like update_file_info, but for a list of many
+	 * NautilusFileInfo at once; update_complete is invoked once all
+	 * of them are done.  The list is only valid during the call.
+	 * Providers without it are called one file at a time. */
+	NautilusOperationResult (*update_file_info_list) (NautilusInfoProvider     *provider,
+							  GList                    *files,
+							  GClosure                 *update_complete,
+							  NautilusOperationHandle **handle);
 };
 
 /* Interface Functions */
@@ -68,6 +77,11 @@ NautilusOperationResult nautilus_info_provider_update_file_info       (NautilusI
 								       NautilusOperationHandle **handle);
 void                    nautilus_info_provider_cancel_update          (NautilusInfoProvider     *provider,
 								       NautilusOperationHandle  *handle);
+gboolean                nautilus_info_provider_can_update_file_info_list (NautilusInfoProvider  *provider);
+NautilusOperationResult nautilus_info_provider_update_file_info_list  (NautilusInfoProvider     *provider,
+								       GList                    *files,
+								       GClosure                 *update_complete,
+								       NautilusOperationHandle **handle);
 
 
 
@@ -46,6 +46,7 @@ static GDebugKey keys[] = {
   { "IconView", NAUTILUS_DEBUG_CANVAS_VIEW },
   { "ListView", NAUTILUS_DEBUG_LIST_VIEW },
   { "Mime", NAUTILUS_DEBUG_MIME },
+  { "Modules", NAUTILUS_DEBUG_MODULES },
   { "Places", NAUTILUS_DEBUG_PLACES },
   { "Previewer", NAUTILUS_DEBUG_PREVIEWER },
   { "Search", NAUTILUS_DEBUG_SEARCH },
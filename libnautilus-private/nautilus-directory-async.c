@@ -1588,8 +1588,9 @@ nautilus_async_destroying_file (NautilusFile *file)
 		directory->details->link_info_read_state->file = NULL;
 		changed = TRUE;
 	}
-	if (directory->details->extension_info_file == file) {
-		directory->details->extension_info_file = NULL;
+	if (g_list_find (directory->details->extension_info_files, file) != NULL) {
+		directory->details->extension_info_files =
+			g_list_remove (directory->details->extension_info_files, file);
 		changed = TRUE;
 	}
 
@@ -3699,6 +3700,7 @@ thumbnail_done (NautilusDirectory *directory,
 	
 	file->details->thumbnail_is_up_to_date = TRUE;
 	file->details->thumbnail_tried_original  = tried_original;
+	nautilus_file_forget_scaled_thumbnails (file);
 	if (file->details->thumbnail) {
 		g_object_unref (file->details->thumbnail);
 		file->details->thumbnail = NULL;
@@ -4288,7 +4290,8 @@ extension_info_cancel (NautilusDirectory *directory)
 		}
 
 		directory->details->extension_info_in_progress = NULL;
-		directory->details->extension_info_file = NULL;
+		g_list_free (directory->details->extension_info_files);
+		directory->details->extension_info_files = NULL;
 		directory->details->extension_info_provider = NULL;
 		directory->details->extension_info_idle = 0;
 
@@ -4301,9 +4304,10 @@ extension_info_stop (NautilusDirectory *directory)
 {
 	if (directory->details->extension_info_in_progress != NULL) {
 		NautilusFile *file;
+		GList *l;
 
-		file = directory->details->extension_info_file;
-		if (file != NULL) {
+		for (l = directory->details->extension_info_files; l != NULL; l = l->next) {
+			file = l->data;
 			g_assert (NAUTILUS_IS_FILE (file));
 			g_assert (file->details->directory == directory);
 			if (is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
@@ -4317,22 +4321,39 @@ extension_info_stop (NautilusDirectory *directory)
 }
 
 static void
-finish_info_provider (NautilusDirectory *directory,
-		      NautilusFile *file,
+remove_info_provider (NautilusFile *file,
 		      NautilusInfoProvider *provider)
 {
+	GList *link;
+
+	link = g_list_find (file->details->pending_info_providers, provider);
+	if (link == NULL) {
+		return;
+	}
+
 	file->details->pending_info_providers = 
-		g_list_remove  (file->details->pending_info_providers,
-				provider);
+		g_list_delete_link (file->details->pending_info_providers, link);
 	g_object_unref (provider);
 
-	nautilus_directory_async_state_changed (directory);
-
 	if (file->details->pending_info_providers == NULL) {
 		nautilus_file_info_providers_done (file);
 	}
 }
 
+static void
+finish_info_provider (NautilusDirectory *directory,
+		      GList *files,
+		      NautilusInfoProvider *provider)
+{
+	GList *l;
+
+	for (l = files; l != NULL; l = l->next) {
+		remove_info_provider (l->data, provider);
+	}
+
+	nautilus_directory_async_state_changed (directory);
+}
+
 
 static gboolean
 info_provider_idle_callback (gpointer user_data)
@@ -4347,17 +4368,18 @@ info_provider_idle_callback (gpointer user_data)
 	    || response->provider != directory->details->extension_info_provider) {
 		g_warning ("Unexpected plugin response.  This probably indicates a bug in a Nautilus extension: handle=%p", response->handle);
 	} else {
-		NautilusFile *file;
+		GList *files;
 		async_job_end (directory, "extension info");
 
-		file = directory->details->extension_info_file;
+		files = directory->details->extension_info_files;
 
-		directory->details->extension_info_file = NULL;
+		directory->details->extension_info_files = NULL;
 		directory->details->extension_info_provider = NULL;
 		directory->details->extension_info_in_progress = NULL;
 		directory->details->extension_info_idle = 0;
 		
-		finish_info_provider (directory, file, response->provider);
+		finish_info_provider (directory, files, response->provider);
+		g_list_free (files);
 	}
 
 	return FALSE;
@@ -4383,6 +4405,50 @@ info_provider_callback (NautilusInfoProvider *provider,
 				 g_free);
 }
 
+/* Providers that take lists get the files waiting for them in batches
+ * of this size, instead of one file per job.
+ */
+#define EXTENSION_INFO_BATCH_SIZE 256
+
+static GList *
+get_extension_info_batch (NautilusDirectory *directory,
+			  NautilusFile *file,
+			  NautilusInfoProvider *provider)
+{
+	GList *files, *l;
+	NautilusFile *other;
+	int count;
+
+	files = g_list_prepend (NULL, file);
+	count = 1;
+
+	if (!nautilus_info_provider_can_update_file_info_list (provider)) {
+		return files;
+	}
+
+	/* Files whose info could come from the cache are left for
+	 * extension_info_start(); restoring it here would emit changes
+	 * while walking the queue.
+	 */
+	for (l = nautilus_file_queue_peek (directory->details->extension_queue);
+	     l != NULL && count < EXTENSION_INFO_BATCH_SIZE;
+	     l = l->next) {
+		other = l->data;
+
+		if (other == file ||
+		    !is_needy (other, lacks_extension_info, REQUEST_EXTENSION_INFO) ||
+		    nautilus_file_can_restore_extension_info (other) ||
+		    other->details->pending_info_providers->data != provider) {
+			continue;
+		}
+
+		files = g_list_prepend (files, other);
+		count++;
+	}
+
+	return g_list_reverse (files);
+}
+
 static void
 extension_info_start (NautilusDirectory *directory,
 		      NautilusFile *file,
@@ -4392,6 +4458,7 @@ extension_info_start (NautilusDirectory *directory,
 	NautilusOperationResult result;
 	NautilusOperationHandle *handle;
 	GClosure *update_complete;
+	GList *files;
 
 	if (directory->details->extension_info_in_progress != NULL) {
 		*doing_io = TRUE;
@@ -4401,6 +4468,13 @@ extension_info_start (NautilusDirectory *directory,
 	if (!is_needy (file, lacks_extension_info, REQUEST_EXTENSION_INFO)) {
 		return;
 	}
+
+	/* Nothing to do if the providers already told us about the
+	 * file as it is now.
+	 */
+	if (nautilus_file_restore_extension_info (file)) {
+		return;
+	}
 	*doing_io = TRUE;
 
 	if (!async_job_start (directory, "extension info")) {
@@ -4408,29 +4482,39 @@ extension_info_start (NautilusDirectory *directory,
 	}
 
 	provider = file->details->pending_info_providers->data;
+	files = get_extension_info_batch (directory, file, provider);
 
 	update_complete = g_cclosure_new (G_CALLBACK (info_provider_callback),
 					  directory,
 					  NULL);
 	g_closure_set_marshal (update_complete,
 			       g_cclosure_marshal_generic);
-			       
-	result = nautilus_info_provider_update_file_info
-		(provider, 
-		 NAUTILUS_FILE_INFO (file), 
-		 update_complete, 
-		 &handle);
+
+	if (nautilus_info_provider_can_update_file_info_list (provider)) {
+		result = nautilus_info_provider_update_file_info_list
+			(provider,
+			 files,
+			 update_complete,
+			 &handle);
+	} else {
+		result = nautilus_info_provider_update_file_info
+			(provider, 
+			 NAUTILUS_FILE_INFO (file), 
+			 update_complete, 
+			 &handle);
+	}
 
 	g_closure_unref (update_complete);
 
 	if (result == NAUTILUS_OPERATION_COMPLETE ||
 	    result == NAUTILUS_OPERATION_FAILED) {
-		finish_info_provider (directory, file, provider);
 		async_job_end (directory, "extension info");
+		finish_info_provider (directory, files, provider);
+		g_list_free (files);
 	} else {
 		directory->details->extension_info_in_progress = handle;
 		directory->details->extension_info_provider = provider;
-		directory->details->extension_info_file = file;
+		directory->details->extension_info_files = files;
 	}
 }
 
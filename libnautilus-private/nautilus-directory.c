@@ -59,10 +59,27 @@ static GParamSpec *properties[NUM_PROPERTIES] = { NULL, };
 
 static GHashTable *directories;
 
+/* The same directories, indexed by the components of their URI, so
+ * that everything below a location can be found without looking at
+ * the other directories.
+ */
+typedef struct DirectoryNode DirectoryNode;
+
+struct DirectoryNode {
+	DirectoryNode *parent;
+	char *name;
+	/* Name -> DirectoryNode, NULL until there are children */
+	GHashTable *children;
+	NautilusDirectory *directory;
+};
+
+static DirectoryNode directory_tree;
+
 static void               nautilus_directory_finalize         (GObject                *object);
 static NautilusDirectory *nautilus_directory_new              (GFile                  *location);
 static GList *            real_get_file_list                  (NautilusDirectory      *directory);
 static gboolean		  real_is_editable                    (NautilusDirectory      *directory);
+static void               warm_directory_grew                 (NautilusDirectory      *directory);
 static void               set_directory_location              (NautilusDirectory      *directory,
 							       GFile                  *location);
 
@@ -197,6 +214,122 @@ nautilus_directory_unref (NautilusDirectory *directory)
 	g_object_unref (directory);
 }
 
+static char **
+get_location_components (GFile *location)
+{
+	char **components;
+	char *uri;
+	gsize length;
+
+	/* "file:///" is the parent of "file:///home", not its sibling */
+	uri = g_file_get_uri (location);
+	length = strlen (uri);
+	if (length > 0 && uri[length - 1] == '/') {
+		uri[length - 1] = '\0';
+	}
+
+	components = g_strsplit (uri, "/", -1);
+	g_free (uri);
+
+	return components;
+}
+
+static DirectoryNode *
+directory_tree_lookup (GFile *location,
+		       gboolean create)
+{
+	DirectoryNode *node, *child;
+	char **components;
+	int i;
+
+	components = get_location_components (location);
+
+	node = &directory_tree;
+	for (i = 0; components[i] != NULL; i++) {
+		child = NULL;
+		if (node->children != NULL) {
+			child = g_hash_table_lookup (node->children, components[i]);
+		}
+
+		if (child == NULL) {
+			if (!create) {
+				node = NULL;
+				break;
+			}
+
+			if (node->children == NULL) {
+				node->children = g_hash_table_new (g_str_hash, g_str_equal);
+			}
+			child = g_slice_new0 (DirectoryNode);
+			child->parent = node;
+			child->name = g_strdup (components[i]);
+			g_hash_table_insert (node->children, child->name, child);
+		}
+
+		node = child;
+	}
+
+	g_strfreev (components);
+
+	return node;
+}
+
+static void
+directory_tree_insert (NautilusDirectory *directory)
+{
+	DirectoryNode *node;
+
+	node = directory_tree_lookup (directory->details->location, TRUE);
+	node->directory = directory;
+}
+
+static void
+directory_tree_remove (NautilusDirectory *directory)
+{
+	DirectoryNode *node, *parent;
+
+	node = directory_tree_lookup (directory->details->location, FALSE);
+	if (node == NULL || node->directory != directory) {
+		return;
+	}
+
+	node->directory = NULL;
+
+	/* Prune the branch up to the first node that is still used */
+	while (node != &directory_tree &&
+	       node->directory == NULL &&
+	       (node->children == NULL || g_hash_table_size (node->children) == 0)) {
+		parent = node->parent;
+		g_hash_table_remove (parent->children, node->name);
+		if (node->children != NULL) {
+			g_hash_table_destroy (node->children);
+		}
+		g_free (node->name);
+		g_slice_free (DirectoryNode, node);
+		node = parent;
+	}
+}
+
+static void
+directory_tree_collect (DirectoryNode *node,
+			GList **directories_out)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (node->directory != NULL) {
+		*directories_out = g_list_prepend (*directories_out,
+						   nautilus_directory_ref (node->directory));
+	}
+
+	if (node->children != NULL) {
+		g_hash_table_iter_init (&iter, node->children);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			directory_tree_collect (value, directories_out);
+		}
+	}
+}
+
 static void
 nautilus_directory_finalize (GObject *object)
 {
@@ -205,6 +338,7 @@ nautilus_directory_finalize (GObject *object)
 	directory = NAUTILUS_DIRECTORY (object);
 
 	g_hash_table_remove (directories, directory->details->location);
+	directory_tree_remove (directory);
 
 	nautilus_directory_cancel (directory);
 	g_assert (directory->details->count_in_progress == NULL);
@@ -397,6 +531,7 @@ nautilus_directory_get_internal (GFile *location, gboolean create)
 		g_hash_table_insert (directories,
 				     directory->details->location,
 				     directory);
+		directory_tree_insert (directory);
 	}
 
 	return directory;
@@ -792,6 +927,7 @@ nautilus_directory_emit_files_added (NautilusDirectory *directory,
 		g_signal_emit (directory,
 				 signals[FILES_ADDED], 0,
 				 added_files);
+		warm_directory_grew (directory);
 	}
 	nautilus_profile_end (NULL);
 }
@@ -828,6 +964,7 @@ nautilus_directory_emit_done_loading (NautilusDirectory *directory)
 {
 	g_signal_emit (directory,
 			 signals[DONE_LOADING], 0);
+	warm_directory_grew (directory);
 }
 
 void
@@ -839,38 +976,48 @@ nautilus_directory_emit_load_error (NautilusDirectory *directory,
 			 error);
 }
 
-/* Return a directory object for this one's parent. */
+/* Notifications mostly come in batches for files in the same folder,
+ * so remember the last parent instead of looking it up for each file.
+ */
+typedef struct {
+	GFile *parent;
+	NautilusDirectory *directory;
+} ParentCache;
+
 static NautilusDirectory *
-get_parent_directory (GFile *location)
+parent_cache_get (ParentCache *cache,
+		  GFile *location,
+		  gboolean create)
 {
-	NautilusDirectory *directory;
 	GFile *parent;
 
 	parent = g_file_get_parent (location);
-	if (parent) {
-		directory = nautilus_directory_get_internal (parent, TRUE);
+	if (parent == NULL) {
+		return NULL;
+	}
+
+	/* The cached directory may have been moved elsewhere since */
+	if (cache->parent != NULL && g_file_equal (parent, cache->parent) &&
+	    (cache->directory == NULL ||
+	     g_file_equal (parent, cache->directory->details->location))) {
 		g_object_unref (parent);
-		return directory;
+	} else {
+		g_clear_object (&cache->parent);
+		nautilus_directory_unref (cache->directory);
+
+		cache->parent = parent;
+		cache->directory = nautilus_directory_get_internal (parent, create);
 	}
-	return NULL;
+
+	return nautilus_directory_ref (cache->directory);
 }
 
-/* If a directory object exists for this one's parent, then
- * return it, otherwise return NULL.
- */
-static NautilusDirectory *
-get_parent_directory_if_exists (GFile *location)
+static void
+parent_cache_clear (ParentCache *cache)
 {
-	NautilusDirectory *directory;
-	GFile *parent;
-
-	parent = g_file_get_parent (location);
-	if (parent) {
-		directory = nautilus_directory_get_internal (parent, FALSE);
-		g_object_unref (parent);
-		return directory;
-	}
-	return NULL;
+	g_clear_object (&cache->parent);
+	nautilus_directory_unref (cache->directory);
+	cache->directory = NULL;
 }
 
 static void
@@ -983,6 +1130,7 @@ nautilus_directory_notify_files_added (GList *files)
 	GHashTable *parent_directories;
 	NautilusFile *file;
 	GFile *location, *parent;
+	ParentCache parent_cache = { NULL, NULL };
 
 	nautilus_profile_start (NULL);
 
@@ -996,7 +1144,7 @@ nautilus_directory_notify_files_added (GList *files)
 		location = p->data;
 
 		/* See if the directory is already known. */
-		directory = get_parent_directory_if_exists (location);
+		directory = parent_cache_get (&parent_cache, location, FALSE);
 		if (directory == NULL) {
 			/* In case the directory is not being
 			 * monitored, but the corresponding file is,
@@ -1046,6 +1194,8 @@ nautilus_directory_notify_files_added (GList *files)
 		nautilus_directory_unref (directory);
 	}
 
+	parent_cache_clear (&parent_cache);
+
 	/* Now get file info for the new files. This creates NautilusFile
 	 * objects for the new files, and sends out a files_added signal. 
 	 */
@@ -1153,6 +1303,7 @@ nautilus_directory_notify_files_removed (GList *files)
 	GHashTable *parent_directories;
 	NautilusFile *file;
 	GFile *location;
+	ParentCache parent_cache = { NULL, NULL };
 
 	/* Make a list of changed files in each directory. */
 	changed_lists = g_hash_table_new (NULL, NULL);
@@ -1165,7 +1316,7 @@ nautilus_directory_notify_files_removed (GList *files)
 		location = p->data;
 
 		/* Update file count for parent directory if anyone might care. */
-		directory = get_parent_directory_if_exists (location);
+		directory = parent_cache_get (&parent_cache, location, FALSE);
 		if (directory != NULL) {
 			collect_parent_directories (parent_directories, directory);
 			nautilus_directory_unref (directory);
@@ -1183,6 +1334,8 @@ nautilus_directory_notify_files_removed (GList *files)
 		nautilus_file_unref (file);
 	}
 
+	parent_cache_clear (&parent_cache);
+
 	/* Now send out the changed signals. */
 	g_hash_table_foreach (changed_lists, call_files_changed_unref_free_list, NULL);
 	g_hash_table_destroy (changed_lists);
@@ -1226,59 +1379,39 @@ change_directory_location (NautilusDirectory *directory,
 
 	g_hash_table_remove (directories,
 			     directory->details->location);
+	directory_tree_remove (directory);
 
 	set_directory_location (directory, new_location);
 
 	g_hash_table_insert (directories,
 			     directory->details->location,
 			     directory);
-}
-
-typedef struct {
-	GFile *container;
-	GList *directories;
-} CollectData;
-
-static void
-collect_directories_by_container (gpointer key, gpointer value, gpointer callback_data)
-{
-	NautilusDirectory *directory;
-	CollectData *collect_data;
-	GFile *location;
-
-	location = (GFile *) key;
-	directory = NAUTILUS_DIRECTORY (value);
-	collect_data = (CollectData *) callback_data;
-
-	if (g_file_has_prefix (location, collect_data->container) ||
-	    g_file_equal (collect_data->container, location)) {
-		nautilus_directory_ref (directory);
-		collect_data->directories =
-			g_list_prepend (collect_data->directories,
-					directory);
-	}
+	directory_tree_insert (directory);
 }
 
 static GList *
 nautilus_directory_moved_internal (GFile *old_location,
 				   GFile *new_location)
 {
-	CollectData collection;
+	DirectoryNode *tree_node;
+	GList *moved_directories;
 	NautilusDirectory *directory;
 	GList *node, *affected_files;
 	GFile *new_directory_location;
 	char *relative_path;
 
-	collection.container = old_location;
-	collection.directories = NULL;
+	/* Only the directories below old_location are affected */
+	tree_node = directory_tree_lookup (old_location, FALSE);
+	if (tree_node == NULL) {
+		return NULL;
+	}
 
-	g_hash_table_foreach (directories,
-			      collect_directories_by_container,
-			      &collection);
+	moved_directories = NULL;
+	directory_tree_collect (tree_node, &moved_directories);
 
 	affected_files = NULL;
 
-	for (node = collection.directories; node != NULL; node = node->next) {
+	for (node = moved_directories; node != NULL; node = node->next) {
 		directory = NAUTILUS_DIRECTORY (node->data);
 		new_directory_location = NULL;
 
@@ -1312,7 +1445,7 @@ nautilus_directory_moved_internal (GFile *old_location,
 		nautilus_directory_unref (directory);
 	}
 
-	g_list_free (collection.directories);
+	g_list_free (moved_directories);
 
 	return affected_files;
 }
@@ -1361,6 +1494,7 @@ nautilus_directory_notify_files_moved (GList *file_pairs)
 	char *name;
 	NautilusFileAttributes cancel_attributes;
 	GFile *to_location, *from_location;
+	ParentCache parent_cache = { NULL, NULL };
 	
 	/* Make a list of added and changed files in each directory. */
 	new_files_list = NULL;
@@ -1418,7 +1552,7 @@ nautilus_directory_notify_files_moved (GList *file_pairs)
 				(old_directory, file, cancel_attributes);
 
 			/* Locate the new directory. */
-			new_directory = get_parent_directory (to_location);
+			new_directory = parent_cache_get (&parent_cache, to_location, TRUE);
 			collect_parent_directories (parent_directories, new_directory);
 			/* We can unref now -- new_directory is in the
 			 * parent directories list so it will be
@@ -1450,6 +1584,8 @@ nautilus_directory_notify_files_moved (GList *file_pairs)
 		}
 	}
 
+	parent_cache_clear (&parent_cache);
+
 	/* Now send out the changed and added signals for existing file objects. */
 	g_hash_table_foreach (changed_lists, call_files_changed_free_list, NULL);
 	g_hash_table_destroy (changed_lists);
@@ -1593,6 +1729,326 @@ nautilus_directory_cancel_callback (NautilusDirectory *directory,
 		(directory, callback, callback_data);
 }
 
+/* Warm directories
+ *
+ * Recently viewed directories are kept alive with their file list and
+ * their monitor, so going back to one of them doesn't have to read it
+ * again. The cache holds a ref and monitors the file list like any
+ * other client. Its size is bounded by the number of directories and
+ * by the total number of files in them. The least recently viewed
+ * directories are dropped first. Remote directories are slow to keep
+ * monitored and may go away, so they are not kept.
+ */
+
+#define WARM_CACHE_DIRECTORIES 16
+#define WARM_CACHE_MAX_FILES 50000
+
+/* Most recently viewed first */
+static GQueue warm_directories = G_QUEUE_INIT;
+static guint warm_directories_trim_id = 0;
+
+static void
+warm_directory_drop (GList *link)
+{
+	NautilusDirectory *directory;
+
+	directory = link->data;
+	g_queue_delete_link (&warm_directories, link);
+
+	NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (directory))->file_monitor_remove
+		(directory, &warm_directories);
+	nautilus_directory_unref (directory);
+}
+
+static void
+warm_directories_trim (void)
+{
+	NautilusDirectory *directory;
+	GList *l, *next;
+	guint n_files;
+	int n_directories;
+
+	n_files = 0;
+	n_directories = 0;
+
+	for (l = warm_directories.head; l != NULL; l = next) {
+		next = l->next;
+		directory = l->data;
+
+		n_files += g_hash_table_size (directory->details->file_hash);
+		if (++n_directories > WARM_CACHE_DIRECTORIES ||
+		    (l != warm_directories.head && n_files > WARM_CACHE_MAX_FILES)) {
+			warm_directory_drop (l);
+		}
+	}
+}
+
+static gboolean
+warm_directories_trim_callback (gpointer data)
+{
+	warm_directories_trim_id = 0;
+	warm_directories_trim ();
+
+	return FALSE;
+}
+
+/* Directories are empty when they are added, the file limit has to be
+ * checked again as they fill up. Trimming is left to an idle since the
+ * directory may be in the middle of emitting a signal.
+ */
+static void
+warm_directory_grew (NautilusDirectory *directory)
+{
+	if (warm_directories_trim_id == 0 &&
+	    g_queue_find (&warm_directories, directory) != NULL) {
+		warm_directories_trim_id = g_idle_add (warm_directories_trim_callback, NULL);
+	}
+}
+
+static void
+warm_directory_touch (NautilusDirectory *directory)
+{
+	GList *link;
+
+	/* Only plain local directories, not searches or the desktop */
+	if (!NAUTILUS_IS_VFS_DIRECTORY (directory) ||
+	    !nautilus_directory_is_local (directory)) {
+		return;
+	}
+
+	link = g_queue_find (&warm_directories, directory);
+	if (link != NULL) {
+		g_queue_unlink (&warm_directories, link);
+		g_queue_push_head_link (&warm_directories, link);
+		return;
+	}
+
+	NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (directory))->file_monitor_add
+		(directory, &warm_directories,
+		 TRUE,
+		 NAUTILUS_FILE_ATTRIBUTE_INFO,
+		 NULL, NULL);
+	g_queue_push_head (&warm_directories, nautilus_directory_ref (directory));
+
+	warm_directories_trim ();
+}
+
+/* Prefetching
+ *
+ * Callers pass the directories the user is likely to open next, such as
+ * the selected folder or the parent. They are loaded one at a time, in
+ * the background, and kept monitored until they are opened, replaced by
+ * newer guesses or expire. A real load of any other directory cancels
+ * the one being prefetched right away, so prefetching never competes
+ * with what the user is waiting for.
+ */
+
+#define PREFETCH_MAX_DIRECTORIES 4
+#define PREFETCH_EXPIRE_SECONDS 60
+
+typedef struct {
+	NautilusDirectory *directory;
+	gboolean loading;
+	gboolean loaded;
+} Prefetch;
+
+/* Most recent guess first */
+static GList *prefetches = NULL;
+static guint prefetch_expire_id = 0;
+static guint n_prefetched = 0;
+static guint n_prefetch_hits = 0;
+
+static void prefetch_start_next (void);
+
+static void
+prefetch_report (const char *what)
+{
+	nautilus_profile_msg ("prefetch %s, %u hits of %u prefetched",
+			      what, n_prefetch_hits, n_prefetched);
+}
+
+static void
+prefetch_ready_callback (NautilusDirectory *directory,
+			 GList *files,
+			 gpointer callback_data)
+{
+	Prefetch *prefetch = callback_data;
+
+	prefetch->loading = FALSE;
+	prefetch->loaded = TRUE;
+
+	prefetch_start_next ();
+}
+
+static void
+prefetch_drop (GList *link)
+{
+	Prefetch *prefetch;
+
+	prefetch = link->data;
+	prefetches = g_list_delete_link (prefetches, link);
+
+	if (prefetch->loading) {
+		nautilus_directory_cancel_callback (prefetch->directory,
+						    prefetch_ready_callback, prefetch);
+	}
+	NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (prefetch->directory))->file_monitor_remove
+		(prefetch->directory, &prefetches);
+	nautilus_directory_unref (prefetch->directory);
+	g_slice_free (Prefetch, prefetch);
+}
+
+static void
+prefetch_start_next (void)
+{
+	Prefetch *prefetch;
+	GList *l;
+
+	for (l = prefetches; l != NULL; l = l->next) {
+		prefetch = l->data;
+		if (prefetch->loading) {
+			return;
+		}
+	}
+
+	for (l = prefetches; l != NULL; l = l->next) {
+		prefetch = l->data;
+		if (prefetch->loaded) {
+			continue;
+		}
+
+		n_prefetched++;
+		prefetch->loading = TRUE;
+		NAUTILUS_DIRECTORY_CLASS (G_OBJECT_GET_CLASS (prefetch->directory))->file_monitor_add
+			(prefetch->directory, &prefetches,
+			 TRUE,
+			 NAUTILUS_FILE_ATTRIBUTE_INFO,
+			 NULL, NULL);
+		nautilus_directory_call_when_ready (prefetch->directory,
+						    NAUTILUS_FILE_ATTRIBUTE_INFO,
+						    TRUE,
+						    prefetch_ready_callback, prefetch);
+		return;
+	}
+}
+
+static gboolean
+prefetch_expire (gpointer user_data)
+{
+	prefetch_expire_id = 0;
+
+	while (prefetches != NULL) {
+		prefetch_drop (prefetches);
+	}
+	prefetch_report ("expired");
+
+	return FALSE;
+}
+
+/* Called when a client starts monitoring @directory for real */
+static void
+prefetch_directory_used (NautilusDirectory *directory)
+{
+	Prefetch *prefetch;
+	GList *l, *next;
+
+	for (l = prefetches; l != NULL; l = next) {
+		next = l->next;
+		prefetch = l->data;
+
+		if (prefetch->directory == directory) {
+			if (prefetch->loading || prefetch->loaded) {
+				n_prefetch_hits++;
+				prefetch_report ("hit");
+			}
+			prefetch_drop (l);
+		} else if (prefetch->loading) {
+			/* Don't get in the way of the real load */
+			prefetch_drop (l);
+		}
+	}
+}
+
+void
+nautilus_directory_prefetch (GList *locations)
+{
+	NautilusDirectory *directory;
+	Prefetch *prefetch;
+	GList *l, *link, *guesses;
+	int n;
+
+	guesses = NULL;
+	for (l = locations; l != NULL; l = l->next) {
+		/* Keep the I/O cheap */
+		if (!g_file_is_native (l->data)) {
+			continue;
+		}
+
+		directory = nautilus_directory_get_existing (l->data);
+		if (directory != NULL &&
+		    nautilus_directory_are_all_files_seen (directory) &&
+		    nautilus_directory_is_file_list_monitored (directory)) {
+			/* Already loaded and kept up to date */
+			nautilus_directory_unref (directory);
+			continue;
+		}
+		if (directory == NULL) {
+			directory = nautilus_directory_get (l->data);
+		}
+		if (!NAUTILUS_IS_VFS_DIRECTORY (directory)) {
+			nautilus_directory_unref (directory);
+			continue;
+		}
+
+		for (link = prefetches; link != NULL; link = link->next) {
+			prefetch = link->data;
+			if (prefetch->directory == directory) {
+				break;
+			}
+		}
+
+		if (link != NULL) {
+			prefetches = g_list_remove_link (prefetches, link);
+			nautilus_directory_unref (directory);
+		} else {
+			prefetch = g_slice_new0 (Prefetch);
+			prefetch->directory = directory;
+			link = g_list_prepend (NULL, prefetch);
+		}
+		guesses = g_list_concat (guesses, link);
+	}
+
+	prefetches = g_list_concat (guesses, prefetches);
+
+	n = 0;
+	for (l = prefetches; l != NULL; l = link) {
+		link = l->next;
+		if (++n > PREFETCH_MAX_DIRECTORIES) {
+			prefetch_drop (l);
+		}
+	}
+
+	if (prefetch_expire_id != 0) {
+		g_source_remove (prefetch_expire_id);
+	}
+	prefetch_expire_id = g_timeout_add_seconds (PREFETCH_EXPIRE_SECONDS,
+						    prefetch_expire, NULL);
+
+	prefetch_start_next ();
+}
+
+void
+nautilus_directory_get_prefetch_statistics (guint *prefetched,
+					    guint *hits)
+{
+	if (prefetched != NULL) {
+		*prefetched = n_prefetched;
+	}
+	if (hits != NULL) {
+		*hits = n_prefetch_hits;
+	}
+}
+
 void
 nautilus_directory_file_monitor_add (NautilusDirectory *directory,
 				     gconstpointer client,
@@ -1609,6 +2065,9 @@ nautilus_directory_file_monitor_add (NautilusDirectory *directory,
 		 monitor_hidden_files,
 		 file_attributes,
 		 callback, callback_data);
+
+	prefetch_directory_used (directory);
+	warm_directory_touch (directory);
 }
 
 void
@@ -1836,6 +2295,19 @@ nautilus_directory_number_outstanding (void)
         return directories ? g_hash_table_size (directories) : 0;
 }
 
+static void
+warm_directories_clear (void)
+{
+	if (warm_directories_trim_id != 0) {
+		g_source_remove (warm_directories_trim_id);
+		warm_directories_trim_id = 0;
+	}
+
+	while (warm_directories.head != NULL) {
+		warm_directory_drop (warm_directories.head);
+	}
+}
+
 void
 nautilus_self_check_directory (void)
 {
@@ -1884,6 +2356,7 @@ nautilus_self_check_directory (void)
 	nautilus_file_unref (file);
 
 	nautilus_directory_file_monitor_remove (directory, &data_dummy);
+	warm_directories_clear ();
 
 	nautilus_directory_unref (directory);
 
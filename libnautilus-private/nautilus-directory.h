@@ -198,6 +198,11 @@ void               nautilus_directory_file_monitor_add         (NautilusDirector
 								gpointer                   callback_data);
 void               nautilus_directory_file_monitor_remove      (NautilusDirectory         *directory,
 								gconstpointer              client);
+
+/* Load directories that are likely to be opened next, in the background. */
+void               nautilus_directory_prefetch                 (GList                     *locations);
+void               nautilus_directory_get_prefetch_statistics  (guint                     *prefetched,
+								guint                     *hits);
 void               nautilus_directory_force_reload             (NautilusDirectory         *directory);
 
 /* Get a list of all files currently known in the directory. */
@@ -24,6 +24,7 @@
 #include "nautilus-file-changes-queue.h"
 
 #include "nautilus-directory-notify.h"
+#include "nautilus-mpsc-queue.h"
 
 typedef enum {
 	CHANGE_FILE_INITIAL,
@@ -43,30 +44,18 @@ typedef struct {
 	int screen;
 } NautilusFileChange;
 
-typedef struct {
-	GList *head;
-	GList *tail;
-	GMutex mutex;
-} NautilusFileChangesQueue;
-
-static NautilusFileChangesQueue *
-nautilus_file_changes_queue_new (void)
-{
-	NautilusFileChangesQueue *result;
-
-	result = g_new0 (NautilusFileChangesQueue, 1);
-	g_mutex_init (&result->mutex);
-
-	return result;
-}
+/* File operation jobs queue changes from their worker threads while
+ * the main thread consumes them.
+ */
+typedef NautilusMpscQueue NautilusFileChangesQueue;
 
 static NautilusFileChangesQueue *
 nautilus_file_changes_queue_get (void)
 {
 	static NautilusFileChangesQueue *file_changes_queue;
 
-	if (file_changes_queue == NULL) {
-		file_changes_queue = nautilus_file_changes_queue_new ();
+	if (g_once_init_enter (&file_changes_queue)) {
+		g_once_init_leave (&file_changes_queue, nautilus_mpsc_queue_new ());
 	}
 
 	return file_changes_queue;
@@ -76,14 +65,7 @@ static void
 nautilus_file_changes_queue_add_common (NautilusFileChangesQueue *queue, 
 	NautilusFileChange *new_item)
 {
-	/* enqueue the new queue item while locking down the list */
-	g_mutex_lock (&queue->mutex);
-
-	queue->head = g_list_prepend (queue->head, new_item);
-	if (queue->tail == NULL)
-		queue->tail = queue->head;
-
-	g_mutex_unlock (&queue->mutex);
+	nautilus_mpsc_queue_push (queue, new_item);
 }
 
 void
@@ -179,28 +161,9 @@ nautilus_file_changes_queue_schedule_position_remove (GFile *location)
 static NautilusFileChange *
 nautilus_file_changes_queue_get_change (NautilusFileChangesQueue *queue)
 {
-	GList *new_tail;
-	NautilusFileChange *result;
-
 	g_assert (queue != NULL);
-	
-	/* dequeue the tail item while locking down the list */
-	g_mutex_lock (&queue->mutex);
-
-	if (queue->tail == NULL) {
-		result = NULL;
-	} else {
-		new_tail = queue->tail->prev;
-		result = queue->tail->data;
-		queue->head = g_list_remove_link (queue->head,
-						  queue->tail);
-		g_list_free_1 (queue->tail);
-		queue->tail = new_tail;
-	}
-
-	g_mutex_unlock (&queue->mutex);
 
-	return result;
+	return nautilus_mpsc_queue_pop (queue);
 }
 
 enum {
@@ -65,6 +65,8 @@
 #include "nautilus-file-conflict-dialog.h"
 #include "nautilus-file-undo-operations.h"
 #include "nautilus-file-undo-manager.h"
+#include "nautilus-local-copy.h"
+#include "nautilus-job-scheduler.h"
 
 /* TODO: TESTING!!! */
 
@@ -86,6 +88,9 @@ typedef struct {
 	gboolean delete_all;
 } CommonJob;
 
+typedef struct ParallelCopy ParallelCopy;
+typedef struct StreamingScan StreamingScan;
+
 typedef struct {
 	CommonJob common;
 	gboolean is_move;
@@ -99,6 +104,10 @@ typedef struct {
 	gchar *target_name;
 	NautilusCopyCallback  done_callback;
 	gpointer done_callback_data;
+	/* Set while copy_files() hands regular files to worker threads */
+	ParallelCopy *parallel;
+	/* Set while the sources are still being counted */
+	StreamingScan *scan;
 } CopyMoveJob;
 
 typedef struct {
@@ -170,6 +179,8 @@ typedef struct {
 typedef struct {
 	int num_files;
 	goffset num_bytes;
+	/* Copied by parallel copy workers for files that are not done yet */
+	goffset num_bytes_in_flight;
 	OpKind op;
 	guint64 last_report_time;
 	int last_reported_files_left;
@@ -1426,6 +1437,20 @@ report_delete_progress (CommonJob *job,
 	}
 	transfer_info->last_report_time = now;
 	
+	nautilus_progress_info_take_status (job->progress,
+					    f (_("Deleting files")));
+
+	if (source_info->num_files == 0) {
+		/* Nothing was counted, as when emptying the trash */
+		nautilus_progress_info_take_details (job->progress,
+						     f (ngettext ("%'d file deleted",
+								  "%'d files deleted",
+								  transfer_info->num_files),
+							transfer_info->num_files));
+		nautilus_progress_info_pulse_progress (job->progress);
+		return;
+	}
+
 	files_left = source_info->num_files - transfer_info->num_files;
 
 	/* Races and whatnot could cause this to be negative... */
@@ -1438,9 +1463,6 @@ report_delete_progress (CommonJob *job,
 				    files_left),
 			  files_left);
 
-	nautilus_progress_info_take_status (job->progress,
-					    f (_("Deleting files")));
-
 	elapsed = g_timer_elapsed (job->time, NULL);
 	if (elapsed < SECONDS_NEEDED_FOR_RELIABLE_TRANSFER_RATE) {
 
@@ -1698,6 +1720,347 @@ delete_file (CommonJob *job, GFile *file,
 	*skipped_file = TRUE;
 }
 
+/* Parallel delete
+ *
+ * Folders are handed to a pool of workers. A worker enumerates its
+ * folder, unlinks the files in it right away and queues the subfolders
+ * as new work. Each folder counts the children that are not gone yet,
+ * and the last child to go removes the folder, so folders are removed
+ * bottom-up as soon as they are empty. Anything that fails is handed
+ * back to the job thread. There it goes through delete_file() as
+ * before, which asks the user and retries serially. A folder with a
+ * skipped child is kept, and so are its parents.
+ */
+
+#define PARALLEL_DELETE_WORKERS 4
+#define PARALLEL_DELETE_PROGRESS_INTERVAL (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct {
+	CommonJob *job;
+	GThreadPool *pool;
+	/* DeleteNodes that need the job thread, pushed by the workers */
+	GAsyncQueue *queue;
+	/* Errors are not reported, failed files are just left behind */
+	gboolean ignore_errors;
+
+	volatile gint files_deleted;
+	/* Only touched by the job thread */
+	int files_reported;
+	int roots_left;
+} ParallelDelete;
+
+typedef enum {
+	DELETE_NODE_QUEUED,
+	/* Could not be deleted by a worker */
+	DELETE_NODE_FAILED,
+	/* A toplevel file is finished */
+	DELETE_NODE_DONE
+} DeleteNodeState;
+
+typedef struct DeleteNode DeleteNode;
+
+struct DeleteNode {
+	GFile *file;
+	DeleteNode *parent;
+	DeleteNodeState state;
+	gboolean is_dir;
+	/* Only delete the contents, used for the trash itself */
+	gboolean keep;
+
+	/* Children not deleted yet, plus one while enumerating */
+	volatile gint pending;
+	volatile gint skipped;
+	gboolean enumerate_failed;
+};
+
+static void parallel_delete_node_done (ParallelDelete *parallel,
+				       DeleteNode *node);
+
+static DeleteNode *
+delete_node_new (GFile *file,
+		 DeleteNode *parent,
+		 gboolean is_dir)
+{
+	DeleteNode *node;
+
+	node = g_slice_new0 (DeleteNode);
+	node->file = g_object_ref (file);
+	node->parent = parent;
+	node->is_dir = is_dir;
+	node->pending = 1;
+
+	return node;
+}
+
+static void
+delete_node_free (DeleteNode *node)
+{
+	g_object_unref (node->file);
+	g_slice_free (DeleteNode, node);
+}
+
+static void
+parallel_delete_file_removed (ParallelDelete *parallel,
+			      GFile *file)
+{
+	nautilus_file_changes_queue_file_removed (file);
+	g_atomic_int_inc (&parallel->files_deleted);
+}
+
+static void
+parallel_delete_node_failed (ParallelDelete *parallel,
+			     DeleteNode *node)
+{
+	if (parallel->ignore_errors) {
+		node->skipped = TRUE;
+		parallel_delete_node_done (parallel, node);
+		return;
+	}
+
+	node->state = DELETE_NODE_FAILED;
+	g_async_queue_push (parallel->queue, node);
+}
+
+/* Called once all children of a folder are gone or skipped */
+static void
+parallel_delete_dir_empty (ParallelDelete *parallel,
+			   DeleteNode *node)
+{
+	CommonJob *job;
+
+	job = parallel->job;
+
+	if (g_atomic_int_get (&node->skipped) ||
+	    node->keep ||
+	    job_aborted (job)) {
+		parallel_delete_node_done (parallel, node);
+	} else if (node->enumerate_failed ||
+		   !g_file_delete (node->file, job->cancellable, NULL)) {
+		parallel_delete_node_failed (parallel, node);
+	} else {
+		parallel_delete_file_removed (parallel, node->file);
+		parallel_delete_node_done (parallel, node);
+	}
+}
+
+static void
+parallel_delete_node_done (ParallelDelete *parallel,
+			   DeleteNode *node)
+{
+	DeleteNode *parent;
+
+	parent = node->parent;
+	if (parent == NULL) {
+		node->state = DELETE_NODE_DONE;
+		g_async_queue_push (parallel->queue, node);
+		return;
+	}
+
+	if (node->skipped || job_aborted (parallel->job)) {
+		g_atomic_int_set (&parent->skipped, TRUE);
+	}
+	delete_node_free (node);
+
+	if (g_atomic_int_dec_and_test (&parent->pending)) {
+		parallel_delete_dir_empty (parallel, parent);
+	}
+}
+
+static void
+parallel_delete_worker (gpointer data,
+			gpointer user_data)
+{
+	DeleteNode *node = data;
+	ParallelDelete *parallel = user_data;
+	CommonJob *job;
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GFile *child;
+	DeleteNode *child_node;
+	GError *error;
+
+	job = parallel->job;
+
+	if (job_aborted (job)) {
+		node->skipped = TRUE;
+		parallel_delete_node_done (parallel, node);
+		return;
+	}
+
+	if (!node->is_dir) {
+		/* A toplevel file, which may or may not be a folder */
+		error = NULL;
+		if (g_file_delete (node->file, job->cancellable, &error)) {
+			parallel_delete_file_removed (parallel, node->file);
+			parallel_delete_node_done (parallel, node);
+			return;
+		}
+
+		if (!IS_IO_ERROR (error, NOT_EMPTY)) {
+			if (IS_IO_ERROR (error, CANCELLED)) {
+				node->skipped = TRUE;
+				parallel_delete_node_done (parallel, node);
+			} else {
+				parallel_delete_node_failed (parallel, node);
+			}
+			g_error_free (error);
+			return;
+		}
+		g_error_free (error);
+
+		node->is_dir = TRUE;
+	}
+
+	error = NULL;
+	enumerator = g_file_enumerate_children (node->file,
+						G_FILE_ATTRIBUTE_STANDARD_NAME ","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						job->cancellable,
+						&error);
+	if (enumerator) {
+		while (!job_aborted (job) &&
+		       (info = g_file_enumerator_next_file (enumerator, job->cancellable, &error)) != NULL) {
+			child = g_file_get_child (node->file,
+						  g_file_info_get_name (info));
+
+			/* skip_files is only written while scanning, so this is safe */
+			if (should_skip_file (job, child)) {
+				g_atomic_int_set (&node->skipped, TRUE);
+			} else if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+				child_node = delete_node_new (child, node, TRUE);
+				g_atomic_int_inc (&node->pending);
+				g_thread_pool_push (parallel->pool, child_node, NULL);
+			} else if (g_file_delete (child, job->cancellable, NULL)) {
+				parallel_delete_file_removed (parallel, child);
+			} else {
+				child_node = delete_node_new (child, node, FALSE);
+				g_atomic_int_inc (&node->pending);
+				parallel_delete_node_failed (parallel, child_node);
+			}
+
+			g_object_unref (child);
+			g_object_unref (info);
+		}
+		g_file_enumerator_close (enumerator, job->cancellable, NULL);
+		g_object_unref (enumerator);
+	}
+
+	if (error != NULL) {
+		if (!IS_IO_ERROR (error, CANCELLED)) {
+			/* Retried and reported by delete_dir() once the rest is done */
+			node->enumerate_failed = TRUE;
+		}
+		g_error_free (error);
+	}
+
+	if (g_atomic_int_dec_and_test (&node->pending)) {
+		parallel_delete_dir_empty (parallel, node);
+	}
+}
+
+static ParallelDelete *
+parallel_delete_new (CommonJob *job,
+		     gboolean ignore_errors)
+{
+	ParallelDelete *parallel;
+
+	parallel = g_slice_new0 (ParallelDelete);
+	parallel->job = job;
+	parallel->ignore_errors = ignore_errors;
+	parallel->queue = g_async_queue_new ();
+	parallel->pool = g_thread_pool_new (parallel_delete_worker,
+					    parallel,
+					    PARALLEL_DELETE_WORKERS,
+					    FALSE,
+					    NULL);
+
+	return parallel;
+}
+
+static void
+parallel_delete_push (ParallelDelete *parallel,
+		      GFile *file,
+		      gboolean keep)
+{
+	DeleteNode *node;
+
+	/* The trash itself is known to be a folder */
+	node = delete_node_new (file, NULL, keep);
+	node->keep = keep;
+
+	parallel->roots_left++;
+	g_thread_pool_push (parallel->pool, node, NULL);
+}
+
+static void
+parallel_delete_report_progress (ParallelDelete *parallel,
+				 SourceInfo *source_info,
+				 TransferInfo *transfer_info)
+{
+	int files_deleted;
+
+	files_deleted = g_atomic_int_get (&parallel->files_deleted);
+	transfer_info->num_files += files_deleted - parallel->files_reported;
+	parallel->files_reported = files_deleted;
+
+	report_delete_progress (parallel->job, source_info, transfer_info);
+}
+
+/* Waits for all toplevel files, returns how many were skipped */
+static int
+parallel_delete_finish (ParallelDelete *parallel,
+			SourceInfo *source_info,
+			TransferInfo *transfer_info)
+{
+	DeleteNode *node;
+	CommonJob *job;
+	gboolean skipped_file;
+	int files_skipped;
+
+	job = parallel->job;
+	files_skipped = 0;
+
+	while (parallel->roots_left > 0) {
+		node = g_async_queue_timeout_pop (parallel->queue,
+						  PARALLEL_DELETE_PROGRESS_INTERVAL);
+		if (node == NULL) {
+			parallel_delete_report_progress (parallel, source_info, transfer_info);
+			continue;
+		}
+
+		if (node->state == DELETE_NODE_DONE) {
+			parallel->roots_left--;
+			if (node->skipped) {
+				files_skipped++;
+			}
+			delete_node_free (node);
+		} else {
+			/* Let the serial path deal with it, it can ask the user */
+			skipped_file = FALSE;
+			if (job_aborted (job)) {
+				skipped_file = TRUE;
+			} else {
+				delete_file (job, node->file,
+					     &skipped_file,
+					     source_info, transfer_info,
+					     node->parent == NULL);
+			}
+			node->skipped = skipped_file;
+			node->state = DELETE_NODE_QUEUED;
+			parallel_delete_node_done (parallel, node);
+		}
+
+		parallel_delete_report_progress (parallel, source_info, transfer_info);
+	}
+
+	g_thread_pool_free (parallel->pool, FALSE, TRUE);
+	g_async_queue_unref (parallel->queue);
+	g_slice_free (ParallelDelete, parallel);
+
+	return files_skipped;
+}
+
 static void
 delete_files (CommonJob *job, GList *files, int *files_skipped)
 {
@@ -1705,7 +2068,7 @@ delete_files (CommonJob *job, GList *files, int *files_skipped)
 	GFile *file;
 	SourceInfo source_info;
 	TransferInfo transfer_info;
-	gboolean skipped_file;
+	ParallelDelete *parallel;
 	
 	if (job_aborted (job)) {
 		return;
@@ -1723,21 +2086,23 @@ delete_files (CommonJob *job, GList *files, int *files_skipped)
 	
 	memset (&transfer_info, 0, sizeof (transfer_info));
 	report_delete_progress (job, &source_info, &transfer_info);
+
+	parallel = parallel_delete_new (job, FALSE);
 	
 	for (l = files;
 	     l != NULL && !job_aborted (job);
 	     l = l->next) {
 		file = l->data;
 
-		skipped_file = FALSE;
-		delete_file (job, file,
-			     &skipped_file,
-			     &source_info, &transfer_info,
-			     TRUE);
-		if (skipped_file) {
+		if (should_skip_file (job, file)) {
 			(*files_skipped)++;
+			continue;
 		}
+
+		parallel_delete_push (parallel, file, FALSE);
 	}
+
+	*files_skipped += parallel_delete_finish (parallel, &source_info, &transfer_info);
 }
 
 static void
@@ -1994,11 +2359,18 @@ trash_or_delete_internal (GList                  *files,
 		job->common.undo_info = nautilus_file_undo_info_trash_new (g_list_length (files));
 	}
 
-	g_io_scheduler_push_job (delete_job,
-			   job,
-			   NULL,
-			   0,
-			   NULL);
+	if (try_trash) {
+		/* Trashing is mostly renames, don't queue it behind other jobs */
+		g_io_scheduler_push_job (delete_job,
+				   job,
+				   NULL,
+				   0,
+				   NULL);
+	} else {
+		nautilus_job_scheduler_push (delete_job, job,
+					     job->files, NULL,
+					     job->common.progress);
+	}
 }
 
 void
@@ -2307,11 +2679,9 @@ nautilus_file_operations_unmount_mount_full (GtkWindow                      *par
 			job->trash_dirs = get_trash_dirs_for_mount (mount);
 			job->done_callback = empty_trash_for_unmount_done;
 			job->done_callback_data = data;
-			g_io_scheduler_push_job (empty_trash_job,
-					   job,
-					   NULL,
-					   0,
-					   NULL);
+			nautilus_job_scheduler_push (empty_trash_job, job,
+						     job->trash_dirs, NULL,
+						     job->common.progress);
 			return;
 		} else if (response == GTK_RESPONSE_CANCEL) {
 			if (callback) {
@@ -2911,52 +3281,314 @@ verify_destination (CommonJob *job,
 	g_object_unref (fsinfo);
 }
 
+/* Streaming scan
+ *
+ * Copies and moves don't wait for the source tree to be counted. A
+ * scanner thread walks the sources while the job is already copying.
+ * The job thread picks up its running totals whenever it reports
+ * progress. The scanner never asks the user anything: any folder it
+ * cannot read will fail again, and be reported, when it is copied.
+ */
+
+/* How long to wait for the count before the first free space check.
+ * Small copies are fully counted by then and behave as before.
+ */
+#define STREAMING_SCAN_INITIAL_WAIT (250 * G_TIME_SPAN_MILLISECOND)
+#define STREAMING_SCAN_PUBLISH_INTERVAL 100
+
+struct StreamingScan {
+	GThread *thread;
+	GList *files;
+	GCancellable *cancellable;
+	/* Where the free space is checked once the count is complete */
+	GFile *dest;
+	/* Only touched by the job thread */
+	gboolean verified;
+
+	GMutex mutex;
+	GCond cond;
+	int num_files;
+	goffset num_bytes;
+	gboolean done;
+};
+
 static void
-report_copy_progress (CopyMoveJob *copy_job,
-		      SourceInfo *source_info,
-		      TransferInfo *transfer_info)
+streaming_scan_publish (StreamingScan *scan,
+			int *num_files,
+			goffset *num_bytes)
 {
-	int files_left;
-	goffset total_size;
-	double elapsed, transfer_rate;
-	int remaining_time;
-	guint64 now;
-	CommonJob *job;
-	gboolean is_move;
+	g_mutex_lock (&scan->mutex);
+	scan->num_files += *num_files;
+	scan->num_bytes += *num_bytes;
+	g_mutex_unlock (&scan->mutex);
 
-	job = (CommonJob *)copy_job;
+	*num_files = 0;
+	*num_bytes = 0;
+}
 
-	is_move = copy_job->is_move;
-	
-	now = g_get_monotonic_time ();
+static gpointer
+streaming_scan_thread (gpointer user_data)
+{
+	StreamingScan *scan = user_data;
+	GQueue dirs = G_QUEUE_INIT;
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GFile *dir;
+	GList *l;
+	int num_files;
+	goffset num_bytes;
 
-	if (transfer_info->last_report_time != 0 &&
-	    ABS ((gint64)(transfer_info->last_report_time - now)) < 100 * NSEC_PER_MICROSEC) {
-		return;
+	num_files = 0;
+	num_bytes = 0;
+
+	for (l = scan->files; l != NULL; l = l->next) {
+		info = g_file_query_info (l->data,
+					  G_FILE_ATTRIBUTE_STANDARD_TYPE","
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+					  scan->cancellable,
+					  NULL);
+		if (info == NULL) {
+			continue;
+		}
+
+		num_files++;
+		num_bytes += g_file_info_get_size (info);
+		if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+			g_queue_push_tail (&dirs, g_object_ref (l->data));
+		}
+		g_object_unref (info);
 	}
-	transfer_info->last_report_time = now;
-	
-	files_left = source_info->num_files - transfer_info->num_files;
 
-	/* Races and whatnot could cause this to be negative... */
-	if (files_left < 0) {
-		files_left = 1;
+	while (!g_cancellable_is_cancelled (scan->cancellable) &&
+	       (dir = g_queue_pop_head (&dirs)) != NULL) {
+		enumerator = g_file_enumerate_children (dir,
+							G_FILE_ATTRIBUTE_STANDARD_NAME","
+							G_FILE_ATTRIBUTE_STANDARD_TYPE","
+							G_FILE_ATTRIBUTE_STANDARD_SIZE,
+							G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+							scan->cancellable,
+							NULL);
+		if (enumerator != NULL) {
+			while ((info = g_file_enumerator_next_file (enumerator, scan->cancellable, NULL)) != NULL) {
+				num_files++;
+				num_bytes += g_file_info_get_size (info);
+
+				if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY) {
+					/* Push to head, since we want depth-first */
+					g_queue_push_head (&dirs,
+							   g_file_get_child (dir, g_file_info_get_name (info)));
+				}
+				g_object_unref (info);
+
+				if (num_files >= STREAMING_SCAN_PUBLISH_INTERVAL) {
+					streaming_scan_publish (scan, &num_files, &num_bytes);
+				}
+			}
+			g_file_enumerator_close (enumerator, NULL, NULL);
+			g_object_unref (enumerator);
+		}
+		g_object_unref (dir);
 	}
 
-	if (files_left != transfer_info->last_reported_files_left ||
-	    transfer_info->last_reported_files_left == 0) {
-		/* Avoid changing this unless files_left changed since last time */
-		transfer_info->last_reported_files_left = files_left;
-		
-		if (source_info->num_files == 1) {
-			if (copy_job->destination != NULL) {
-				nautilus_progress_info_take_status (job->progress,
-								    f (is_move ?
-								       _("Moving “%B” to “%B”"):
-								       _("Copying “%B” to “%B”"),
-								       copy_job->fake_display_source != NULL ?
-								       copy_job->fake_display_source :
-								       (GFile *)copy_job->files->data,
+	g_queue_foreach (&dirs, (GFunc) g_object_unref, NULL);
+	g_queue_clear (&dirs);
+
+	streaming_scan_publish (scan, &num_files, &num_bytes);
+
+	g_mutex_lock (&scan->mutex);
+	scan->done = TRUE;
+	g_cond_broadcast (&scan->cond);
+	g_mutex_unlock (&scan->mutex);
+
+	return NULL;
+}
+
+static StreamingScan *
+streaming_scan_start (GList *files,
+		      GFile *dest)
+{
+	StreamingScan *scan;
+
+	scan = g_slice_new0 (StreamingScan);
+	scan->files = g_list_copy_deep (files, (GCopyFunc) g_object_ref, NULL);
+	scan->cancellable = g_cancellable_new ();
+	scan->dest = g_object_ref (dest);
+	g_mutex_init (&scan->mutex);
+	g_cond_init (&scan->cond);
+
+	scan->thread = g_thread_new ("nautilus-scan", streaming_scan_thread, scan);
+
+	return scan;
+}
+
+/* Copies the current totals into @source_info and returns whether
+ * they are final.
+ */
+static gboolean
+streaming_scan_sync (StreamingScan *scan,
+		     SourceInfo *source_info)
+{
+	gboolean done;
+
+	g_mutex_lock (&scan->mutex);
+	source_info->num_files = scan->num_files;
+	source_info->num_bytes = scan->num_bytes;
+	done = scan->done;
+	g_mutex_unlock (&scan->mutex);
+
+	return done;
+}
+
+static void
+streaming_scan_wait (StreamingScan *scan,
+		     gint64 timeout)
+{
+	gint64 end_time;
+
+	end_time = g_get_monotonic_time () + timeout;
+
+	g_mutex_lock (&scan->mutex);
+	while (!scan->done) {
+		if (!g_cond_wait_until (&scan->cond, &scan->mutex, end_time)) {
+			break;
+		}
+	}
+	g_mutex_unlock (&scan->mutex);
+}
+
+static void
+streaming_scan_free (StreamingScan *scan)
+{
+	g_cancellable_cancel (scan->cancellable);
+	g_thread_join (scan->thread);
+
+	g_list_free_full (scan->files, g_object_unref);
+	g_object_unref (scan->cancellable);
+	g_object_unref (scan->dest);
+	g_mutex_clear (&scan->mutex);
+	g_cond_clear (&scan->cond);
+	g_slice_free (StreamingScan, scan);
+}
+
+/* Starts counting @files and checks the destination against what was
+ * counted in the first moments.
+ */
+static void
+streaming_scan_sources (CopyMoveJob *job,
+			GList *files,
+			GFile *dest,
+			char **dest_fs_id,
+			SourceInfo *source_info,
+			OpKind kind)
+{
+	CommonJob *common;
+
+	common = &job->common;
+
+	memset (source_info, 0, sizeof (SourceInfo));
+	source_info->op = kind;
+
+	report_count_progress (common, source_info);
+
+	job->scan = streaming_scan_start (files, dest);
+	streaming_scan_wait (job->scan, STREAMING_SCAN_INITIAL_WAIT);
+	job->scan->verified = streaming_scan_sync (job->scan, source_info);
+
+	report_count_progress (common, source_info);
+
+	verify_destination (common,
+			    dest,
+			    dest_fs_id,
+			    source_info->num_bytes);
+}
+
+/* Called between files. Once the count is complete, checks again that
+ * what is left to copy fits.
+ */
+static void
+streaming_scan_check (CopyMoveJob *job,
+		      SourceInfo *source_info,
+		      TransferInfo *transfer_info)
+{
+	StreamingScan *scan;
+
+	scan = job->scan;
+	if (scan == NULL || scan->verified) {
+		return;
+	}
+
+	if (streaming_scan_sync (scan, source_info)) {
+		scan->verified = TRUE;
+		verify_destination (&job->common,
+				    scan->dest,
+				    NULL,
+				    source_info->num_bytes - transfer_info->num_bytes);
+	}
+}
+
+static void
+streaming_scan_finish (CopyMoveJob *job)
+{
+	if (job->scan != NULL) {
+		streaming_scan_free (job->scan);
+		job->scan = NULL;
+	}
+}
+
+static void
+report_copy_progress (CopyMoveJob *copy_job,
+		      SourceInfo *source_info,
+		      TransferInfo *transfer_info)
+{
+	int files_left, total_files;
+	goffset num_bytes, total_size;
+	double elapsed, transfer_rate;
+	int remaining_time;
+	guint64 now;
+	CommonJob *job;
+	gboolean is_move;
+	gboolean counting;
+
+	job = (CommonJob *)copy_job;
+
+	is_move = copy_job->is_move;
+	
+	now = g_get_monotonic_time ();
+
+	if (transfer_info->last_report_time != 0 &&
+	    ABS ((gint64)(transfer_info->last_report_time - now)) < 100 * NSEC_PER_MICROSEC) {
+		return;
+	}
+	transfer_info->last_report_time = now;
+
+	counting = copy_job->scan != NULL &&
+		!streaming_scan_sync (copy_job->scan, source_info);
+
+	/* While counting, the scan can lag behind the copy */
+	total_files = MAX (source_info->num_files, transfer_info->num_files + 1);
+	
+	files_left = source_info->num_files - transfer_info->num_files;
+
+	/* Races and whatnot could cause this to be negative... */
+	if (files_left < 0) {
+		files_left = 1;
+	}
+
+	if (files_left != transfer_info->last_reported_files_left ||
+	    transfer_info->last_reported_files_left == 0) {
+		/* Avoid changing this unless files_left changed since last time */
+		transfer_info->last_reported_files_left = files_left;
+		
+		if (source_info->num_files == 1) {
+			if (copy_job->destination != NULL) {
+				nautilus_progress_info_take_status (job->progress,
+								    f (is_move ?
+								       _("Moving “%B” to “%B”"):
+								       _("Copying “%B” to “%B”"),
+								       copy_job->fake_display_source != NULL ?
+								       copy_job->fake_display_source :
+								       (GFile *)copy_job->files->data,
 								       copy_job->destination));
 			} else {
 				nautilus_progress_info_take_status (job->progress,
@@ -2972,14 +3604,14 @@ report_copy_progress (CopyMoveJob *copy_job,
 								       :
 								       _("Copying file %'d of %'d (in “%B”) to “%B”"),
 								       transfer_info->num_files + 1,
-								       source_info->num_files,
+								       total_files,
 								       (GFile *)copy_job->files->data,
 								       copy_job->destination));
 			} else {
 				nautilus_progress_info_take_status (job->progress,
 								    f (_("Duplicating file %'d of %'d (in “%B”)"),
 								       transfer_info->num_files + 1,
-								       source_info->num_files,
+								       total_files,
 								       (GFile *)copy_job->files->data));
 			}
 		} else {
@@ -2990,34 +3622,43 @@ report_copy_progress (CopyMoveJob *copy_job,
 								       :
 								       _ ("Copying file %'d of %'d to “%B”"),
 								       transfer_info->num_files + 1,
-								       source_info->num_files,
+								       total_files,
 								       copy_job->destination));
 			} else {
 				nautilus_progress_info_take_status (job->progress,
 								    f (_("Duplicating file %'d of %'d"),
 								       transfer_info->num_files + 1,
-								       source_info->num_files));
+								       total_files));
 			}
 		}
 	}
 	
-	total_size = MAX (source_info->num_bytes, transfer_info->num_bytes);
+	num_bytes = transfer_info->num_bytes + transfer_info->num_bytes_in_flight;
+	total_size = MAX (source_info->num_bytes, num_bytes);
 	
 	elapsed = g_timer_elapsed (job->time, NULL);
 	transfer_rate = 0;
 	if (elapsed > 0) {
-		transfer_rate = transfer_info->num_bytes / elapsed;
+		transfer_rate = num_bytes / elapsed;
 	}
 
-	if (elapsed < SECONDS_NEEDED_FOR_RELIABLE_TRANSFER_RATE &&
+	if (counting) {
+		char *s;
+		/* The total is still growing, so there is no telling how
+		 * long this will take.
+		 */
+		/* To translators: %S will expand to a size like "2 bytes" or "3 MB", so something like "4 kb of at least 4 MB" */
+		s = f (_("%S of at least %S"), num_bytes, total_size);
+		nautilus_progress_info_take_details (job->progress, s);
+	} else if (elapsed < SECONDS_NEEDED_FOR_RELIABLE_TRANSFER_RATE &&
 	    transfer_rate > 0) {
 		char *s;
 		/* To translators: %S will expand to a size like "2 bytes" or "3 MB", so something like "4 kb of 4 MB" */		
-		s = f (_("%S of %S"), transfer_info->num_bytes, total_size);
+		s = f (_("%S of %S"), num_bytes, total_size);
 		nautilus_progress_info_take_details (job->progress, s);
 	} else {
 		char *s;
-		remaining_time = (total_size - transfer_info->num_bytes) / transfer_rate;
+		remaining_time = (total_size - num_bytes) / transfer_rate;
 
 		/* To translators: %S will expand to a size like "2 bytes" or "3 MB", %T to a time duration like
 		 * "2 minutes". So the whole thing will be something like "2 kb of 4 MB -- 2 hours left (4kb/sec)"
@@ -3027,13 +3668,13 @@ report_copy_progress (CopyMoveJob *copy_job,
 		s = f (ngettext ("%S of %S \xE2\x80\x94 %T left (%S/sec)",
 				 "%S of %S \xE2\x80\x94 %T left (%S/sec)",
 				 seconds_count_format_time_units (remaining_time)),
-		       transfer_info->num_bytes, total_size,
+		       num_bytes, total_size,
 		       remaining_time,
 		       (goffset)transfer_rate);
 		nautilus_progress_info_take_details (job->progress, s);
 	}
 
-	nautilus_progress_info_set_progress (job->progress, transfer_info->num_bytes, total_size);
+	nautilus_progress_info_set_progress (job->progress, num_bytes, total_size);
 }
 
 static int
@@ -3371,6 +4012,18 @@ static void copy_move_file (CopyMoveJob *job,
 			    gboolean overwrite,
 			    gboolean *skipped_file,
 			    gboolean readonly_source_fs);
+static void parallel_copy_push (ParallelCopy *parallel,
+				GFile *src,
+				GFile *dest_dir,
+				gboolean same_fs,
+				const char *dest_fs_type,
+				gboolean readonly_source_fs,
+				SourceInfo *source_info,
+				TransferInfo *transfer_info);
+static void parallel_copy_defer_attributes (ParallelCopy *parallel,
+					    GFile *src,
+					    GFile *dest,
+					    GFileCopyFlags flags);
 
 typedef enum {
 	CREATE_DEST_DIR_RETRY,
@@ -3499,8 +4152,11 @@ copy_move_directory (CopyMoveJob *copy_job,
 	gboolean local_skipped_file;
 	CommonJob *job;
 	GFileCopyFlags flags;
+	ParallelCopy *parallel;
 
 	job = (CommonJob *)copy_job;
+
+	streaming_scan_check (copy_job, source_info, transfer_info);
 	
 	if (create_dest) {
 		switch (create_dest_dir (job, src, dest, same_fs, parent_dest_fs_type)) {
@@ -3528,12 +4184,20 @@ copy_move_directory (CopyMoveJob *copy_job,
 
 	local_skipped_file = FALSE;
 	dest_fs_type = NULL;
+
+	/* Only local to local copies are worth spreading over threads */
+	parallel = NULL;
+	if (copy_job->parallel != NULL &&
+	    g_file_is_native (src) && g_file_is_native (*dest)) {
+		parallel = copy_job->parallel;
+	}
 	
 	skip_error = should_skip_readdir_error (job, src);
  retry:
 	error = NULL;
 	enumerator = g_file_enumerate_children (src,
-						G_FILE_ATTRIBUTE_STANDARD_NAME,
+						G_FILE_ATTRIBUTE_STANDARD_NAME","
+						G_FILE_ATTRIBUTE_STANDARD_TYPE,
 						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
 						job->cancellable,
 						&error);
@@ -3544,9 +4208,18 @@ copy_move_directory (CopyMoveJob *copy_job,
 		       (info = g_file_enumerator_next_file (enumerator, job->cancellable, skip_error?NULL:&error)) != NULL) {
 			src_file = g_file_get_child (src,
 						     g_file_info_get_name (info));
-			copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
-					source_info, transfer_info, NULL, NULL, FALSE, &local_skipped_file,
-					readonly_source_fs);
+			if (parallel != NULL &&
+			    g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR &&
+			    !should_skip_file (job, src_file)) {
+				/* These don't go through copy_move_file() */
+				streaming_scan_check (copy_job, source_info, transfer_info);
+				parallel_copy_push (parallel, src_file, *dest, same_fs, dest_fs_type,
+						    readonly_source_fs, source_info, transfer_info);
+			} else {
+				copy_move_file (copy_job, src_file, *dest, same_fs, FALSE, &dest_fs_type,
+						source_info, transfer_info, NULL, NULL, FALSE, &local_skipped_file,
+						readonly_source_fs);
+			}
 			g_object_unref (src_file);
 			g_object_unref (info);
 		}
@@ -3641,10 +4314,17 @@ copy_move_directory (CopyMoveJob *copy_job,
 	if (create_dest) {
 		flags = (readonly_source_fs) ? G_FILE_COPY_NOFOLLOW_SYMLINKS | G_FILE_COPY_TARGET_DEFAULT_PERMS 
 					     : G_FILE_COPY_NOFOLLOW_SYMLINKS;
-		/* Ignore errors here. Failure to copy metadata is not a hard error */
-		g_file_copy_attributes (src, *dest,
-					flags,
-					job->cancellable, NULL);
+		if (copy_job->parallel != NULL) {
+			/* Workers may still be writing into the folder,
+			 * so it can't be made read-only yet.
+			 */
+			parallel_copy_defer_attributes (copy_job->parallel, src, *dest, flags);
+		} else {
+			/* Ignore errors here. Failure to copy metadata is not a hard error */
+			g_file_copy_attributes (src, *dest,
+						flags,
+						job->cancellable, NULL);
+		}
 	}
 
 	if (!job_aborted (job) && copy_job->is_move &&
@@ -3845,6 +4525,41 @@ copy_file_progress_callback (goffset current_num_bytes,
 	}
 }
 
+/* Like g_file_copy(), but lets the kernel copy the data of local
+ * regular files.
+ */
+static gboolean
+copy_file_fast (GFile *src,
+		GFile *dest,
+		GFileCopyFlags flags,
+		GCancellable *cancellable,
+		GFileProgressCallback progress_callback,
+		gpointer progress_callback_data,
+		GError **error)
+{
+	GError *local_error;
+
+	local_error = NULL;
+	if (nautilus_local_copy_file (src, dest, flags, cancellable,
+				      progress_callback, progress_callback_data,
+				      &local_error)) {
+		return TRUE;
+	}
+
+	if (!IS_IO_ERROR (local_error, NOT_SUPPORTED)) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+	g_error_free (local_error);
+
+	return g_file_copy (src, dest,
+			    flags,
+			    cancellable,
+			    progress_callback,
+			    progress_callback_data,
+			    error);
+}
+
 static gboolean
 test_dir_is_parent (GFile *child, GFile *root)
 {
@@ -4071,6 +4786,8 @@ copy_move_file (CopyMoveJob *copy_job,
 	gboolean handled_invalid_filename;
 
 	job = (CommonJob *)copy_job;
+
+	streaming_scan_check (copy_job, source_info, transfer_info);
 	
 	if (should_skip_file (job, src)) {
 		*skipped_file = TRUE;
@@ -4185,12 +4902,12 @@ copy_move_file (CopyMoveJob *copy_job,
 				   &pdata,
 				   &error);
 	} else {
-		res = g_file_copy (src, dest,
-				   flags,
-				   job->cancellable,
-				   copy_file_progress_callback,
-				   &pdata,
-				   &error);
+		res = copy_file_fast (src, dest,
+				      flags,
+				      job->cancellable,
+				      copy_file_progress_callback,
+				      &pdata,
+				      &error);
 	}
 	
 	if (res) {
@@ -4449,6 +5166,297 @@ copy_move_file (CopyMoveJob *copy_job,
 	g_object_unref (dest);
 }
 
+/* Parallel copy
+ *
+ * While copying, the job thread walks the source tree as before: it
+ * creates the destination folders in order and handles everything
+ * that may need to ask the user. Regular files inside local folders are
+ * handed to a pool of workers instead of being copied in place. A
+ * worker only tries the plain copy. Anything that fails, such as a
+ * conflict, an invalid file name or an I/O error, is handed back and
+ * goes through copy_move_file() on the job thread, so the conflict
+ * dialog and the skip, merge and replace semantics are unchanged.
+ */
+
+#define PARALLEL_COPY_WORKERS 4
+#define PARALLEL_COPY_MAX_IN_FLIGHT 256
+#define PARALLEL_COPY_PROGRESS_INTERVAL (100 * G_TIME_SPAN_MILLISECOND)
+
+struct ParallelCopy {
+	CopyMoveJob *job;
+	GThreadPool *pool;
+	/* Finished CopyTasks, pushed by the workers */
+	GAsyncQueue *done;
+	/* Only touched by the job thread */
+	int in_flight;
+	GQueue deferred_attributes;
+
+	GMutex mutex;
+	goffset bytes_in_flight;
+};
+
+typedef struct {
+	GFile *src;
+	GFile *dest_dir;
+	gboolean same_fs;
+	char *dest_fs_type;
+	gboolean readonly_source_fs;
+
+	/* Filled in by the worker */
+	ParallelCopy *parallel;
+	GFile *dest;
+	gboolean copied;
+	goffset bytes;
+	GError *error;
+} CopyTask;
+
+typedef struct {
+	GFile *src;
+	GFile *dest;
+	GFileCopyFlags flags;
+} DeferredAttributes;
+
+static void
+copy_task_free (CopyTask *task)
+{
+	g_object_unref (task->src);
+	g_object_unref (task->dest_dir);
+	g_clear_object (&task->dest);
+	g_free (task->dest_fs_type);
+	if (task->error != NULL) {
+		g_error_free (task->error);
+	}
+	g_slice_free (CopyTask, task);
+}
+
+static void
+parallel_copy_progress_callback (goffset current_num_bytes,
+				 goffset total_num_bytes,
+				 gpointer user_data)
+{
+	CopyTask *task = user_data;
+	goffset new_size;
+
+	new_size = current_num_bytes - task->bytes;
+	if (new_size > 0) {
+		task->bytes = current_num_bytes;
+
+		g_mutex_lock (&task->parallel->mutex);
+		task->parallel->bytes_in_flight += new_size;
+		g_mutex_unlock (&task->parallel->mutex);
+	}
+}
+
+static void
+parallel_copy_worker (gpointer data,
+		      gpointer user_data)
+{
+	CopyTask *task = data;
+	ParallelCopy *parallel = user_data;
+	CommonJob *job;
+	GFileCopyFlags flags;
+
+	job = (CommonJob *) parallel->job;
+
+	if (!g_cancellable_is_cancelled (job->cancellable)) {
+		task->dest = get_target_file (task->src, task->dest_dir,
+					      task->dest_fs_type, task->same_fs);
+
+		/* Copying a file over itself is reported by copy_move_file() */
+		if (!g_file_equal (task->src, task->dest)) {
+			flags = G_FILE_COPY_NOFOLLOW_SYMLINKS;
+			if (task->readonly_source_fs) {
+				flags |= G_FILE_COPY_TARGET_DEFAULT_PERMS;
+			}
+
+			task->copied = copy_file_fast (task->src, task->dest,
+						       flags,
+						       job->cancellable,
+						       parallel_copy_progress_callback,
+						       task,
+						       &task->error);
+		}
+	}
+
+	g_async_queue_push (parallel->done, task);
+}
+
+static ParallelCopy *
+parallel_copy_new (CopyMoveJob *job)
+{
+	ParallelCopy *parallel;
+
+	parallel = g_slice_new0 (ParallelCopy);
+	parallel->job = job;
+	parallel->done = g_async_queue_new ();
+	g_queue_init (&parallel->deferred_attributes);
+	g_mutex_init (&parallel->mutex);
+	parallel->pool = g_thread_pool_new (parallel_copy_worker,
+					    parallel,
+					    PARALLEL_COPY_WORKERS,
+					    FALSE,
+					    NULL);
+
+	return parallel;
+}
+
+static void
+parallel_copy_report_progress (ParallelCopy *parallel,
+			       SourceInfo *source_info,
+			       TransferInfo *transfer_info)
+{
+	g_mutex_lock (&parallel->mutex);
+	transfer_info->num_bytes_in_flight = parallel->bytes_in_flight;
+	g_mutex_unlock (&parallel->mutex);
+
+	report_copy_progress (parallel->job, source_info, transfer_info);
+}
+
+static void
+parallel_copy_task_done (ParallelCopy *parallel,
+			 CopyTask *task,
+			 SourceInfo *source_info,
+			 TransferInfo *transfer_info)
+{
+	CommonJob *job;
+	char *dest_fs_type;
+	gboolean skipped_file;
+
+	job = (CommonJob *) parallel->job;
+	parallel->in_flight--;
+
+	g_mutex_lock (&parallel->mutex);
+	parallel->bytes_in_flight -= task->bytes;
+	g_mutex_unlock (&parallel->mutex);
+
+	if (task->copied) {
+		transfer_info->num_bytes += task->bytes;
+		transfer_info->num_files++;
+
+		nautilus_file_changes_queue_file_added (task->dest);
+
+		if (job->undo_info != NULL) {
+			nautilus_file_undo_info_ext_add_origin_target_pair (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
+									    task->src, task->dest);
+		}
+	} else if (!job_aborted (job) &&
+		   (task->error == NULL || !IS_IO_ERROR (task->error, CANCELLED))) {
+		/* Let the serial path deal with it, it can ask the user */
+		dest_fs_type = g_strdup (task->dest_fs_type);
+		skipped_file = FALSE;
+		copy_move_file (parallel->job, task->src, task->dest_dir,
+				task->same_fs, FALSE, &dest_fs_type,
+				source_info, transfer_info,
+				NULL, NULL, FALSE, &skipped_file,
+				task->readonly_source_fs);
+		g_free (dest_fs_type);
+	}
+
+	copy_task_free (task);
+
+	parallel_copy_report_progress (parallel, source_info, transfer_info);
+}
+
+/* Handles finished files until no more than @max_in_flight are left */
+static void
+parallel_copy_wait (ParallelCopy *parallel,
+		    int max_in_flight,
+		    SourceInfo *source_info,
+		    TransferInfo *transfer_info)
+{
+	CopyTask *task;
+
+	while (parallel->in_flight > max_in_flight) {
+		task = g_async_queue_timeout_pop (parallel->done,
+						  PARALLEL_COPY_PROGRESS_INTERVAL);
+		if (task == NULL) {
+			/* Nothing finished, but bytes were copied */
+			parallel_copy_report_progress (parallel, source_info, transfer_info);
+			continue;
+		}
+
+		parallel_copy_task_done (parallel, task, source_info, transfer_info);
+	}
+
+	while (parallel->in_flight > 0 &&
+	       (task = g_async_queue_try_pop (parallel->done)) != NULL) {
+		parallel_copy_task_done (parallel, task, source_info, transfer_info);
+	}
+}
+
+static void
+parallel_copy_push (ParallelCopy *parallel,
+		    GFile *src,
+		    GFile *dest_dir,
+		    gboolean same_fs,
+		    const char *dest_fs_type,
+		    gboolean readonly_source_fs,
+		    SourceInfo *source_info,
+		    TransferInfo *transfer_info)
+{
+	CopyTask *task;
+
+	/* Bound the queue, the scan doesn't need to run far ahead */
+	parallel_copy_wait (parallel, PARALLEL_COPY_MAX_IN_FLIGHT - 1,
+			    source_info, transfer_info);
+
+	task = g_slice_new0 (CopyTask);
+	task->parallel = parallel;
+	task->src = g_object_ref (src);
+	task->dest_dir = g_object_ref (dest_dir);
+	task->same_fs = same_fs;
+	task->dest_fs_type = g_strdup (dest_fs_type);
+	task->readonly_source_fs = readonly_source_fs;
+
+	parallel->in_flight++;
+	g_thread_pool_push (parallel->pool, task, NULL);
+}
+
+static void
+parallel_copy_defer_attributes (ParallelCopy *parallel,
+				GFile *src,
+				GFile *dest,
+				GFileCopyFlags flags)
+{
+	DeferredAttributes *deferred;
+
+	deferred = g_slice_new (DeferredAttributes);
+	deferred->src = g_object_ref (src);
+	deferred->dest = g_object_ref (dest);
+	deferred->flags = flags;
+
+	/* Folders finish after their subfolders, so this is bottom-up */
+	g_queue_push_tail (&parallel->deferred_attributes, deferred);
+}
+
+static void
+parallel_copy_finish (ParallelCopy *parallel,
+		      SourceInfo *source_info,
+		      TransferInfo *transfer_info)
+{
+	DeferredAttributes *deferred;
+	CommonJob *job;
+
+	job = (CommonJob *) parallel->job;
+
+	parallel_copy_wait (parallel, 0, source_info, transfer_info);
+	g_thread_pool_free (parallel->pool, FALSE, TRUE);
+
+	while ((deferred = g_queue_pop_head (&parallel->deferred_attributes)) != NULL) {
+		/* Ignore errors here. Failure to copy metadata is not a hard error */
+		g_file_copy_attributes (deferred->src, deferred->dest,
+					deferred->flags,
+					job->cancellable, NULL);
+		g_object_unref (deferred->src);
+		g_object_unref (deferred->dest);
+		g_slice_free (DeferredAttributes, deferred);
+	}
+
+	g_async_queue_unref (parallel->done);
+	g_mutex_clear (&parallel->mutex);
+	g_slice_free (ParallelCopy, parallel);
+}
+
 static void
 copy_files (CopyMoveJob *job,
 	    const char *dest_fs_id,
@@ -4487,6 +5495,10 @@ copy_files (CopyMoveJob *job,
 		g_object_unref (source_dir);
 	}
 
+	if (!job->is_move) {
+		job->parallel = parallel_copy_new (job);
+	}
+
 	unique_names = (job->destination == NULL);
 	i = 0;
 	for (l = job->files;
@@ -4526,6 +5538,11 @@ copy_files (CopyMoveJob *job,
 		i++;
 	}
 
+	if (job->parallel != NULL) {
+		parallel_copy_finish (job->parallel, source_info, transfer_info);
+		job->parallel = NULL;
+	}
+
 	g_free (dest_fs_type);
 }
 
@@ -4579,14 +5596,6 @@ copy_job (GIOSchedulerJob *io_job,
 	dest_fs_id = NULL;
 	
 	nautilus_progress_info_start (job->common.progress);
-	
-	scan_sources (job->files,
-		      &source_info,
-		      common,
-		      OP_KIND_COPY);
-	if (job_aborted (common)) {
-		goto aborted;
-	}
 
 	if (job->destination) {
 		dest = g_object_ref (job->destination);
@@ -4596,11 +5605,10 @@ copy_job (GIOSchedulerJob *io_job,
 		 */
 		dest = g_file_get_parent (job->files->data);
 	}
-	
-	verify_destination (&job->common,
-			    dest,
-			    &dest_fs_id,
-			    source_info.num_bytes);
+
+	/* Start copying while the sources are still being counted */
+	streaming_scan_sources (job, job->files, dest, &dest_fs_id,
+				&source_info, OP_KIND_COPY);
 	g_object_unref (dest);
 	if (job_aborted (common)) {
 		goto aborted;
@@ -4614,6 +5622,7 @@ copy_job (GIOSchedulerJob *io_job,
 		    &source_info, &transfer_info);
 
  aborted:
+	streaming_scan_finish (job);
 	
 	g_free (dest_fs_id);
 	
@@ -4655,11 +5664,9 @@ nautilus_file_operations_copy_file (GFile *source_file,
 
 	inhibit_power_manager ((CommonJob *)job, _("Copying Files"));
 
-	g_io_scheduler_push_job (copy_job,
-			   job,
-			   NULL, /* destroy notify */
-			   0,
-			   job->common.cancellable);
+	nautilus_job_scheduler_push (copy_job, job,
+				     job->files, job->destination,
+				     job->common.progress);
 }
 
 void
@@ -4700,11 +5707,9 @@ nautilus_file_operations_copy (GList *files,
 		g_object_unref (src_dir);
 	}
 
-	g_io_scheduler_push_job (copy_job,
-			   job,
-			   NULL, /* destroy notify */
-			   0,
-			   job->common.cancellable);
+	nautilus_job_scheduler_push (copy_job, job,
+				     job->files, job->destination,
+				     job->common.progress);
 }
 
 static void
@@ -4991,6 +5996,205 @@ move_file_prepare (CopyMoveJob *move_job,
 	g_object_unref (dest);
 }
 
+/* Batched rename
+ *
+ * Most moves within one filesystem are plain renames into a folder
+ * that has no file of the same name. For local folders the names in
+ * the destination are read once up front, and every source that does
+ * not clash is renamed directly, without the per-file queries of
+ * g_file_move(). Undo records for these are added in one go at the
+ * end. Anything else, or any rename that fails, goes through
+ * move_file_prepare() as before.
+ */
+
+typedef struct {
+	GFile *dest_dir;
+	char *dest_path;
+	const char *dest_fs_id;
+	/* Names in the destination, including the ones moved there */
+	GHashTable *dest_names;
+
+	/* Sources usually share a parent, so remember the last one */
+	GFile *last_parent;
+	gboolean last_parent_same_fs;
+
+	GList *undo_sources;
+	GList *undo_targets;
+} MoveBatch;
+
+static MoveBatch *
+move_batch_new (CommonJob *job,
+		GFile *dest_dir,
+		const char *dest_fs_id)
+{
+	MoveBatch *batch;
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GError *error;
+	char *dest_path;
+
+	if (dest_fs_id == NULL) {
+		return NULL;
+	}
+
+	dest_path = g_file_get_path (dest_dir);
+	if (dest_path == NULL) {
+		return NULL;
+	}
+
+	enumerator = g_file_enumerate_children (dest_dir,
+						G_FILE_ATTRIBUTE_STANDARD_NAME,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						job->cancellable,
+						NULL);
+	if (enumerator == NULL) {
+		g_free (dest_path);
+		return NULL;
+	}
+
+	batch = g_slice_new0 (MoveBatch);
+	batch->dest_dir = g_object_ref (dest_dir);
+	batch->dest_path = dest_path;
+	batch->dest_fs_id = dest_fs_id;
+	batch->dest_names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	error = NULL;
+	while ((info = g_file_enumerator_next_file (enumerator, job->cancellable, &error)) != NULL) {
+		g_hash_table_add (batch->dest_names,
+				  g_strdup (g_file_info_get_name (info)));
+		g_object_unref (info);
+	}
+	g_file_enumerator_close (enumerator, job->cancellable, NULL);
+	g_object_unref (enumerator);
+
+	if (error != NULL) {
+		/* An incomplete list of names can't rule out conflicts */
+		g_error_free (error);
+		g_hash_table_destroy (batch->dest_names);
+		g_object_unref (batch->dest_dir);
+		g_free (batch->dest_path);
+		g_slice_free (MoveBatch, batch);
+		return NULL;
+	}
+
+	return batch;
+}
+
+static void
+move_batch_free (CommonJob *job,
+		 MoveBatch *batch)
+{
+	if (batch == NULL) {
+		return;
+	}
+
+	if (job->undo_info != NULL && batch->undo_sources != NULL) {
+		batch->undo_sources = g_list_reverse (batch->undo_sources);
+		batch->undo_targets = g_list_reverse (batch->undo_targets);
+		nautilus_file_undo_info_ext_add_origin_target_pairs (NAUTILUS_FILE_UNDO_INFO_EXT (job->undo_info),
+								     batch->undo_sources,
+								     batch->undo_targets);
+	}
+
+	g_list_free_full (batch->undo_sources, g_object_unref);
+	g_list_free_full (batch->undo_targets, g_object_unref);
+	g_clear_object (&batch->last_parent);
+	g_hash_table_destroy (batch->dest_names);
+	g_object_unref (batch->dest_dir);
+	g_free (batch->dest_path);
+	g_slice_free (MoveBatch, batch);
+}
+
+static gboolean
+move_batch_same_fs (MoveBatch *batch,
+		    GFile *src)
+{
+	GFile *parent;
+
+	parent = g_file_get_parent (src);
+	if (parent == NULL) {
+		return FALSE;
+	}
+
+	/* A mount point differs from its parent, but rename() refuses those */
+	if (batch->last_parent == NULL ||
+	    !g_file_equal (parent, batch->last_parent)) {
+		g_clear_object (&batch->last_parent);
+		batch->last_parent = g_object_ref (parent);
+		batch->last_parent_same_fs = has_fs_id (parent, batch->dest_fs_id);
+	}
+	g_object_unref (parent);
+
+	return batch->last_parent_same_fs;
+}
+
+/* Returns FALSE if @src needs to go through move_file_prepare() */
+static gboolean
+move_batch_rename (CopyMoveJob *move_job,
+		   MoveBatch *batch,
+		   GFile *src,
+		   GdkPoint *position)
+{
+	CommonJob *job;
+	GFile *dest;
+	char *src_path, *basename, *dest_path;
+	gboolean renamed;
+
+	job = (CommonJob *) move_job;
+
+	src_path = g_file_get_path (src);
+	if (src_path == NULL) {
+		return FALSE;
+	}
+
+	basename = g_path_get_basename (src_path);
+	if (g_hash_table_contains (batch->dest_names, basename) ||
+	    test_dir_is_parent (batch->dest_dir, src) ||
+	    !move_batch_same_fs (batch, src)) {
+		g_free (basename);
+		g_free (src_path);
+		return FALSE;
+	}
+
+	/* dest_names can be out of date or differ in case from what the
+	 * file system considers the same name, so never replace anything;
+	 * a clash goes through the conflict handling of move_file_prepare().
+	 */
+	dest_path = g_build_filename (batch->dest_path, basename, NULL);
+	renamed = nautilus_local_rename_noreplace (src_path, dest_path);
+	g_free (dest_path);
+	g_free (src_path);
+
+	if (!renamed) {
+		g_free (basename);
+		return FALSE;
+	}
+
+	dest = g_file_get_child (batch->dest_dir, basename);
+	g_hash_table_add (batch->dest_names, basename);
+
+	if (move_job->debuting_files) {
+		g_hash_table_replace (move_job->debuting_files, g_object_ref (dest), GINT_TO_POINTER (TRUE));
+	}
+
+	nautilus_file_changes_queue_file_moved (src, dest);
+
+	if (position) {
+		nautilus_file_changes_queue_schedule_position_set (dest, *position, job->screen_num);
+	} else {
+		nautilus_file_changes_queue_schedule_position_remove (dest);
+	}
+
+	if (job->undo_info != NULL) {
+		batch->undo_sources = g_list_prepend (batch->undo_sources, g_object_ref (src));
+		batch->undo_targets = g_list_prepend (batch->undo_targets, dest);
+	} else {
+		g_object_unref (dest);
+	}
+
+	return TRUE;
+}
+
 static void
 move_files_prepare (CopyMoveJob *job,
 		    const char *dest_fs_id,
@@ -5004,6 +6208,7 @@ move_files_prepare (CopyMoveJob *job,
 	int i;
 	GdkPoint *point;
 	int total, left;
+	MoveBatch *batch;
 
 	common = &job->common;
 
@@ -5011,6 +6216,8 @@ move_files_prepare (CopyMoveJob *job,
 
 	report_move_progress (job, total, left);
 
+	batch = move_batch_new (common, job->destination, dest_fs_id);
+
 	i = 0;
 	for (l = job->files;
 	     l != NULL && !job_aborted (common);
@@ -5023,6 +6230,12 @@ move_files_prepare (CopyMoveJob *job,
 			point = NULL;
 		}
 
+		if (batch != NULL &&
+		    move_batch_rename (job, batch, src, point)) {
+			report_move_progress (job, total, --left);
+			i++;
+			continue;
+		}
 		
 		same_fs = FALSE;
 		if (dest_fs_id) {
@@ -5039,6 +6252,8 @@ move_files_prepare (CopyMoveJob *job,
 		i++;
 	}
 
+	move_batch_free (common, batch);
+
 	*fallbacks = g_list_reverse (*fallbacks);
 
 	
@@ -5161,21 +6376,9 @@ move_job (GIOSchedulerJob *io_job,
 	   so scan for size */
 
 	fallback_files = get_files_from_fallbacks (fallbacks);
-	scan_sources (fallback_files,
-		      &source_info,
-		      common,
-		      OP_KIND_MOVE);
-	
+	streaming_scan_sources (job, fallback_files, job->destination, NULL,
+				&source_info, OP_KIND_MOVE);
 	g_list_free (fallback_files);
-	
-	if (job_aborted (common)) {
-		goto aborted;
-	}
-
-	verify_destination (&job->common,
-			    job->destination,
-			    NULL,
-			    source_info.num_bytes);
 	if (job_aborted (common)) {
 		goto aborted;
 	}
@@ -5187,6 +6390,7 @@ move_job (GIOSchedulerJob *io_job,
 		    &source_info, &transfer_info);
 
  aborted:
+	streaming_scan_finish (job);
 	g_list_free_full (fallbacks, g_free);
 
 	g_free (dest_fs_id);
@@ -5245,11 +6449,9 @@ nautilus_file_operations_move (GList *files,
 		g_object_unref (src_dir);
 	}
 
-	g_io_scheduler_push_job (move_job,
-				 job,
-				 NULL, /* destroy notify */
-				 0,
-				 job->common.cancellable);
+	nautilus_job_scheduler_push (move_job, job,
+				     job->files, job->destination,
+				     job->common.progress);
 }
 
 static void
@@ -5603,11 +6805,9 @@ nautilus_file_operations_duplicate (GList *files,
 		g_object_unref (src_dir);
 	}
 
-	g_io_scheduler_push_job (copy_job,
-			   job,
-			   NULL, /* destroy notify */
-			   0,
-			   job->common.cancellable);
+	nautilus_job_scheduler_push (copy_job, job,
+				     job->files, job->destination,
+				     job->common.progress);
 }
 
 static gboolean
@@ -6343,47 +7543,6 @@ nautilus_file_operations_new_file (GtkWidget *parent_view,
 
 
 
-static void
-delete_trash_file (CommonJob *job,
-		   GFile *file,
-		   gboolean del_file,
-		   gboolean del_children)
-{
-	GFileInfo *info;
-	GFile *child;
-	GFileEnumerator *enumerator;
-
-	if (job_aborted (job)) {
-		return;
-	}
-
-	if (del_children) {
-		enumerator = g_file_enumerate_children (file,
-							G_FILE_ATTRIBUTE_STANDARD_NAME ","
-							G_FILE_ATTRIBUTE_STANDARD_TYPE,
-							G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-							job->cancellable,
-							NULL);
-		if (enumerator) {
-			while (!job_aborted (job) &&
-			       (info = g_file_enumerator_next_file (enumerator, job->cancellable, NULL)) != NULL) {
-				child = g_file_get_child (file,
-							  g_file_info_get_name (info));
-				delete_trash_file (job, child, TRUE,
-						   g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY);
-				g_object_unref (child);
-				g_object_unref (info);
-			}
-			g_file_enumerator_close (enumerator, job->cancellable, NULL);
-			g_object_unref (enumerator);
-		}
-	}
-
-	if (!job_aborted (job) && del_file) {
-		g_file_delete (file, job->cancellable, NULL);
-	}
-}
-
 static gboolean
 empty_trash_job_done (gpointer user_data)
 {
@@ -6411,6 +7570,9 @@ empty_trash_job (GIOSchedulerJob *io_job,
 	CommonJob *common;
 	GList *l;
 	gboolean confirmed;
+	ParallelDelete *parallel;
+	SourceInfo source_info;
+	TransferInfo transfer_info;
 	
 	common = (CommonJob *)job;
 	common->io_job = io_job;
@@ -6423,11 +7585,19 @@ empty_trash_job (GIOSchedulerJob *io_job,
 		confirmed = TRUE;
 	}
 	if (confirmed) {
+		/* The trash is not counted up front, progress only shows how much is gone */
+		memset (&source_info, 0, sizeof (source_info));
+		source_info.op = OP_KIND_DELETE;
+		memset (&transfer_info, 0, sizeof (transfer_info));
+		g_timer_start (common->time);
+
+		parallel = parallel_delete_new (common, TRUE);
 		for (l = job->trash_dirs;
 		     l != NULL && !job_aborted (common);
 		     l = l->next) {
-			delete_trash_file (common, l->data, FALSE, TRUE);
+			parallel_delete_push (parallel, l->data, TRUE);
 		}
+		parallel_delete_finish (parallel, &source_info, &transfer_info);
 	}
 
 	g_io_scheduler_job_send_to_mainloop_async (io_job,
@@ -6456,11 +7626,9 @@ nautilus_file_operations_empty_trash (GtkWidget *parent_view)
 
 	inhibit_power_manager ((CommonJob *)job, _("Emptying Trash"));
 	
-	g_io_scheduler_push_job (empty_trash_job,
-			   job,
-			   NULL,
-			   0,
-			   NULL);
+	nautilus_job_scheduler_push (empty_trash_job, job,
+				     job->trash_dirs, NULL,
+				     job->common.progress);
 }
 
 static gboolean
@@ -52,6 +52,13 @@ typedef enum {
 	UNKNOWN
 } Knowledge;
 
+/* One metadata key of a file, the value is an interned eel_ref_str,
+ * or a NULL terminated array of them for list keys. */
+typedef struct {
+	guint id;
+	gpointer value;
+} NautilusFileMetadataEntry;
+
 struct NautilusFileDetails
 {
 	NautilusDirectory *directory;
@@ -101,6 +108,7 @@ struct NautilusFileDetails
 	char *thumbnail_path;
 	GdkPixbuf *thumbnail;
 	time_t thumbnail_mtime;
+	GList *scaled_thumbnails; /* entries of the scaled thumbnail cache */
 	
 	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
 	char *top_left_text;
@@ -134,7 +142,8 @@ struct NautilusFileDetails
 	GHashTable *extension_attributes;
 	GHashTable *pending_extension_attributes;
 
-	GHashTable *metadata;
+	/* Sorted by id, terminated by an entry with id 0 */
+	NautilusFileMetadataEntry *metadata;
 
 	/* Mount for mountpoint or the references GMount for a "mountable" */
 	GMount *mount;
@@ -154,6 +163,7 @@ struct NautilusFileDetails
 	eel_boolean_bit got_file_info                 : 1;
 	eel_boolean_bit get_info_failed               : 1;
 	eel_boolean_bit file_info_is_up_to_date       : 1;
+	eel_boolean_bit extension_info_cache_checked  : 1;
 	
 	eel_boolean_bit got_directory_count           : 1;
 	eel_boolean_bit directory_count_failed        : 1;
@@ -263,6 +273,10 @@ gboolean      nautilus_file_update_name                    (NautilusFile
 							    const char             *name);
 gboolean      nautilus_file_update_metadata_from_info      (NautilusFile           *file,
 							    GFileInfo              *info);
+/* Apply the metadata:: attributes in info on top of the file's metadata,
+ * unset attributes remove the key.  Returns TRUE if anything changed. */
+gboolean      nautilus_file_merge_metadata_from_info       (NautilusFile           *file,
+							    GFileInfo              *info);
 
 gboolean      nautilus_file_update_name_and_directory      (NautilusFile           *file,
 							    const char             *name,
@@ -291,11 +305,15 @@ void                   nautilus_file_invalidate_count_and_mime_list     (Nautilu
 gboolean               nautilus_file_rename_in_progress                 (NautilusFile           *file);
 void                   nautilus_file_invalidate_extension_info_internal (NautilusFile           *file);
 void                   nautilus_file_info_providers_done                (NautilusFile           *file);
+gboolean               nautilus_file_can_restore_extension_info         (NautilusFile           *file);
+gboolean               nautilus_file_restore_extension_info             (NautilusFile           *file);
+void                   nautilus_file_forget_extension_info              (NautilusFile           *file);
 
 
 /* Thumbnailing: */
 void          nautilus_file_set_is_thumbnailing            (NautilusFile           *file,
 							    gboolean                is_thumbnailing);
+void          nautilus_file_forget_scaled_thumbnails       (NautilusFile           *file);
 
 NautilusFileOperation *nautilus_file_operation_new      (NautilusFile                  *file,
 							 NautilusFileOperationCallback  callback,
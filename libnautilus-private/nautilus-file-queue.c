@@ -123,3 +123,9 @@ nautilus_file_queue_is_empty (NautilusFileQueue *queue)
 {
 	return (queue->head == NULL);
 }
+
+GList *
+nautilus_file_queue_peek (NautilusFileQueue *queue)
+{
+	return queue->head;
+}
@@ -49,4 +49,7 @@ NautilusFile *     nautilus_file_queue_head     (NautilusFileQueue *queue);
 
 gboolean           nautilus_file_queue_is_empty (NautilusFileQueue *queue);
 
+/* Get the files in the queue, head first. The list belongs to the queue. */
+GList *            nautilus_file_queue_peek     (NautilusFileQueue *queue);
+
 #endif /* NAUTILUS_FILE_CHANGES_QUEUE_H */
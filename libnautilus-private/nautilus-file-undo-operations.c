@@ -648,6 +648,22 @@ nautilus_file_undo_info_ext_add_origin_target_pair (NautilusFileUndoInfoExt *sel
 		g_list_append (self->priv->destinations, g_object_ref (target));
 }
 
+void
+nautilus_file_undo_info_ext_add_origin_target_pairs (NautilusFileUndoInfoExt *self,
+						     GList                   *origins,
+						     GList                   *targets)
+{
+	g_return_if_fail (g_list_length (origins) == g_list_length (targets));
+
+	/* Walks the existing lists once, instead of once per pair */
+	self->priv->sources =
+		g_list_concat (self->priv->sources,
+			       g_list_copy_deep (origins, (GCopyFunc) g_object_ref, NULL));
+	self->priv->destinations =
+		g_list_concat (self->priv->destinations,
+			       g_list_copy_deep (targets, (GCopyFunc) g_object_ref, NULL));
+}
+
 /* create new file/folder */
 G_DEFINE_TYPE (NautilusFileUndoInfoCreate, nautilus_file_undo_info_create, NAUTILUS_TYPE_FILE_UNDO_INFO)
 
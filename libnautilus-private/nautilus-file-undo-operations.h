@@ -127,6 +127,9 @@ NautilusFileUndoInfo *nautilus_file_undo_info_ext_new (NautilusFileUndoOp op_typ
 void nautilus_file_undo_info_ext_add_origin_target_pair (NautilusFileUndoInfoExt *self,
 							 GFile                   *origin,
 							 GFile                   *target);
+void nautilus_file_undo_info_ext_add_origin_target_pairs (NautilusFileUndoInfoExt *self,
+							  GList                   *origins,
+							  GList                   *targets);
 
 /* create new file/folder */
 #define NAUTILUS_TYPE_FILE_UNDO_INFO_CREATE         (nautilus_file_undo_info_create_get_type ())
@@ -79,6 +79,9 @@
 /* Time in seconds to cache getpwuid results */
 #define GETPWUID_CACHE_TIME (5*60)
 
+/* Bytes of scaled and framed thumbnails to keep around */
+#define SCALED_THUMBNAIL_CACHE_BUDGET (32 * 1024 * 1024)
+
 #define ICON_NAME_THUMBNAIL_LOADING   "image-loading"
 
 #undef NAUTILUS_FILE_DEBUG_REF
@@ -158,12 +161,13 @@ static char *   nautilus_file_get_owner_as_string            (NautilusFile
 							      gboolean               include_real_name);
 static char *   nautilus_file_get_type_as_string             (NautilusFile          *file);
 static char *   nautilus_file_get_detailed_type_as_string    (NautilusFile          *file);
+static const char * peek_type_collation_key                  (NautilusFile          *file);
 static gboolean update_info_and_name                         (NautilusFile          *file,
 							      GFileInfo             *info);
 static const char * nautilus_file_peek_display_name (NautilusFile *file);
 static const char * nautilus_file_peek_display_name_collation_key (NautilusFile *file);
 static void file_mount_unmounted (GMount *mount,  gpointer data);
-static void metadata_hash_free (GHashTable *hash);
+static void metadata_free (NautilusFileMetadataEntry *metadata);
 
 G_DEFINE_TYPE_WITH_CODE (NautilusFile, nautilus_file, G_TYPE_OBJECT,
 			 G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_FILE_INFO,
@@ -276,97 +280,158 @@ nautilus_file_clear_display_name (NautilusFile *file)
 	file->details->edit_name = NULL;
 }
 
-static gboolean
-foreach_metadata_free (gpointer  key,
-		       gpointer  value,
-		       gpointer  user_data)
+static void
+metadata_value_free (guint id,
+		     gpointer value)
 {
-	guint id;
-
-	id = GPOINTER_TO_UINT (key);
+	eel_ref_str *list;
+	int i;
 
 	if (id & METADATA_ID_IS_LIST_MASK) {
-		g_strfreev ((char **)value);
+		list = value;
+		for (i = 0; list[i] != NULL; i++) {
+			eel_ref_str_unref (list[i]);
+		}
+		g_free (list);
 	} else {
-		g_free ((char *)value);
+		eel_ref_str_unref (value);
 	}
-	return TRUE;
 }
 
-
-static void
-metadata_hash_free (GHashTable *hash)
+/* Values are interned, so the many files of a folder that share
+ * e.g. an icon scale or an emblem share the string too. */
+static gpointer
+metadata_value_new (GFileAttributeType type,
+		    gpointer value)
 {
-	g_hash_table_foreach_remove (hash,
-				     foreach_metadata_free,
-				     NULL);
-	g_hash_table_destroy (hash);
+	char **strv;
+	eel_ref_str *list;
+	int i;
+
+	if (type == G_FILE_ATTRIBUTE_TYPE_STRING) {
+		return eel_ref_str_get_unique (value);
+	}
+
+	strv = value;
+	list = g_new (eel_ref_str, g_strv_length (strv) + 1);
+	for (i = 0; strv[i] != NULL; i++) {
+		list[i] = eel_ref_str_get_unique (strv[i]);
+	}
+	list[i] = NULL;
+
+	return list;
 }
 
 static gboolean
-metadata_hash_equal (GHashTable *hash1,
-		     GHashTable *hash2)
+metadata_value_equal (guint id,
+		      gpointer value1,
+		      gpointer value2)
 {
-	GHashTableIter iter;
-	gpointer key1, value1, value2;
-	guint id;
+	eel_ref_str *list1, *list2;
+	int i;
 
-	if (hash1 == NULL && hash2 == NULL) {
-		return TRUE;
+	if (!(id & METADATA_ID_IS_LIST_MASK)) {
+		return value1 == value2;
 	}
 
-	if (hash1 == NULL || hash2 == NULL) {
-		return FALSE;
+	list1 = value1;
+	list2 = value2;
+	for (i = 0; list1[i] != NULL && list1[i] == list2[i]; i++) {
+		;
 	}
+	return list1[i] == list2[i];
+}
 
-	if (g_hash_table_size (hash1) !=
-	    g_hash_table_size (hash2)) {
-		return FALSE;
+static void
+metadata_free (NautilusFileMetadataEntry *metadata)
+{
+	int i;
+
+	if (metadata == NULL) {
+		return;
 	}
 
-	g_hash_table_iter_init (&iter, hash1);
-	while (g_hash_table_iter_next (&iter, &key1, &value1)) {
-		value2 = g_hash_table_lookup (hash2, key1);
-		if (value2 == NULL) {
+	for (i = 0; metadata[i].id != 0; i++) {
+		metadata_value_free (metadata[i].id, metadata[i].value);
+	}
+	g_free (metadata);
+}
+
+static gboolean
+metadata_equal (NautilusFileMetadataEntry *metadata1,
+		NautilusFileMetadataEntry *metadata2)
+{
+	int i;
+
+	if (metadata1 == NULL || metadata2 == NULL) {
+		return metadata1 == metadata2;
+	}
+
+	for (i = 0; metadata1[i].id != 0; i++) {
+		if (metadata1[i].id != metadata2[i].id ||
+		    !metadata_value_equal (metadata1[i].id,
+					   metadata1[i].value,
+					   metadata2[i].value)) {
 			return FALSE;
 		}
-		id = GPOINTER_TO_UINT (key1);
-		if (id & METADATA_ID_IS_LIST_MASK) {
-			if (!eel_g_strv_equal ((char **)value1, (char **)value2)) {
-				return FALSE;
-			}
-		} else {
-			if (strcmp ((char *)value1, (char *)value2) != 0) {
-				return FALSE;
-			}
+	}
+
+	return metadata2[i].id == 0;
+}
+
+static gpointer
+metadata_lookup (NautilusFileMetadataEntry *metadata,
+		 guint id)
+{
+	int i;
+
+	if (metadata == NULL) {
+		return NULL;
+	}
+
+	/* There are only a handful of entries, and they are sorted */
+	for (i = 0; metadata[i].id != 0 && metadata[i].id <= id; i++) {
+		if (metadata[i].id == id) {
+			return metadata[i].value;
 		}
 	}
 
-	return TRUE;
+	return NULL;
+}
+
+static int
+metadata_entry_compare (gconstpointer a,
+			gconstpointer b)
+{
+	const NautilusFileMetadataEntry *entry1 = a, *entry2 = b;
+
+	if (entry1->id < entry2->id) {
+		return -1;
+	}
+	return entry1->id > entry2->id;
 }
 
 static void
 clear_metadata (NautilusFile *file)
 {
-	if (file->details->metadata) {
-		metadata_hash_free (file->details->metadata);
-		file->details->metadata = NULL;
-	}
+	metadata_free (file->details->metadata);
+	file->details->metadata = NULL;
 }
 
-static GHashTable *
+static NautilusFileMetadataEntry *
 get_metadata_from_info (GFileInfo *info)
 {
-	GHashTable *metadata;
+	NautilusFileMetadataEntry *metadata;
 	char **attrs;
 	guint id;
-	int i;
+	int i, n;
 	GFileAttributeType type;
 	gpointer value;
 
 	attrs = g_file_info_list_attributes (info, "metadata");
 
-	metadata = g_hash_table_new (NULL, NULL);
+	metadata = g_new (NautilusFileMetadataEntry, g_strv_length (attrs) + 1);
+	n = 0;
 
 	for (i = 0; attrs[i] != NULL; i++) {
 		id = nautilus_metadata_get_id (attrs[i] + strlen ("metadata::"));
@@ -379,18 +444,28 @@ get_metadata_from_info (GFileInfo *info)
 			continue;
 		}
 
-		if (type == G_FILE_ATTRIBUTE_TYPE_STRING) {
-			g_hash_table_insert (metadata, GUINT_TO_POINTER (id),
-					     g_strdup ((char *)value));
-		} else if (type == G_FILE_ATTRIBUTE_TYPE_STRINGV) {
+		if (type == G_FILE_ATTRIBUTE_TYPE_STRINGV) {
 			id |= METADATA_ID_IS_LIST_MASK;
-			g_hash_table_insert (metadata, GUINT_TO_POINTER (id),
-					     g_strdupv ((char **)value));
+		} else if (type != G_FILE_ATTRIBUTE_TYPE_STRING) {
+			continue;
 		}
+
+		metadata[n].id = id;
+		metadata[n].value = metadata_value_new (type, value);
+		n++;
 	}
 
 	g_strfreev (attrs);
 
+	if (n == 0) {
+		g_free (metadata);
+		return NULL;
+	}
+
+	qsort (metadata, n, sizeof (NautilusFileMetadataEntry), metadata_entry_compare);
+	metadata[n].id = 0;
+	metadata[n].value = NULL;
+
 	return metadata;
 }
 
@@ -401,16 +476,16 @@ nautilus_file_update_metadata_from_info (NautilusFile *file,
 	gboolean changed = FALSE;
 
 	if (g_file_info_has_namespace (info, "metadata")) {
-		GHashTable *metadata;
+		NautilusFileMetadataEntry *metadata;
 
 		metadata = get_metadata_from_info (info);
-		if (!metadata_hash_equal (metadata,
-					  file->details->metadata)) {
+		if (!metadata_equal (metadata,
+				     file->details->metadata)) {
 			changed = TRUE;
 			clear_metadata (file);
 			file->details->metadata = metadata;
 		} else {
-			metadata_hash_free (metadata);
+			metadata_free (metadata);
 		}
 	} else if (file->details->metadata) {
 		changed = TRUE;
@@ -419,6 +494,119 @@ nautilus_file_update_metadata_from_info (NautilusFile *file,
 	return changed;
 }
 
+/* Replaces whatever is stored for the key id with value, which is
+ * owned by the metadata afterwards.  A NULL value removes the key. */
+static gboolean
+metadata_replace (NautilusFileMetadataEntry **metadata,
+		  guint id,
+		  guint value_id,
+		  gpointer value)
+{
+	NautilusFileMetadataEntry *old, *new;
+	int i, n;
+	gboolean changed;
+
+	old = *metadata;
+
+	if (value != NULL &&
+	    metadata_lookup (old, value_id) != NULL &&
+	    metadata_value_equal (value_id, metadata_lookup (old, value_id), value)) {
+		metadata_value_free (value_id, value);
+		return FALSE;
+	}
+
+	for (n = 0; old != NULL && old[n].id != 0; n++) {
+		;
+	}
+
+	new = g_new (NautilusFileMetadataEntry, n + 2);
+	changed = FALSE;
+	n = 0;
+
+	for (i = 0; old != NULL && old[i].id != 0; i++) {
+		if ((old[i].id & ~METADATA_ID_IS_LIST_MASK) == id) {
+			metadata_value_free (old[i].id, old[i].value);
+			changed = TRUE;
+			continue;
+		}
+		if (value != NULL && old[i].id > value_id &&
+		    (n == 0 || new[n - 1].id < value_id)) {
+			new[n].id = value_id;
+			new[n].value = value;
+			n++;
+		}
+		new[n++] = old[i];
+	}
+
+	if (value != NULL && (n == 0 || new[n - 1].id < value_id)) {
+		new[n].id = value_id;
+		new[n].value = value;
+		n++;
+	}
+	if (value != NULL) {
+		changed = TRUE;
+	}
+
+	g_free (old);
+	if (n == 0) {
+		g_free (new);
+		new = NULL;
+	} else {
+		new[n].id = 0;
+		new[n].value = NULL;
+	}
+	*metadata = new;
+
+	return changed;
+}
+
+gboolean
+nautilus_file_merge_metadata_from_info (NautilusFile *file,
+					GFileInfo *info)
+{
+	char **attrs;
+	guint id, value_id;
+	int i;
+	GFileAttributeType type;
+	gpointer value;
+	gboolean changed;
+
+	changed = FALSE;
+	attrs = g_file_info_list_attributes (info, "metadata");
+
+	for (i = 0; attrs[i] != NULL; i++) {
+		id = nautilus_metadata_get_id (attrs[i] + strlen ("metadata::"));
+		if (id == 0) {
+			continue;
+		}
+
+		if (!g_file_info_get_attribute_data (info, attrs[i],
+						     &type, &value, NULL)) {
+			continue;
+		}
+
+		if (type == G_FILE_ATTRIBUTE_TYPE_STRING) {
+			value_id = id;
+			value = metadata_value_new (type, value);
+		} else if (type == G_FILE_ATTRIBUTE_TYPE_STRINGV) {
+			value_id = id | METADATA_ID_IS_LIST_MASK;
+			value = metadata_value_new (type, value);
+		} else {
+			/* Unset attributes remove the key */
+			value_id = id;
+			value = NULL;
+		}
+
+		if (metadata_replace (&file->details->metadata, id, value_id, value)) {
+			changed = TRUE;
+		}
+	}
+
+	g_strfreev (attrs);
+
+	return changed;
+}
+
 void
 nautilus_file_clear_info (NautilusFile *file)
 {
@@ -803,6 +991,7 @@ finalize (GObject *object)
 	g_free (file->details->activation_uri);
 	g_clear_object (&file->details->custom_icon);
 
+	nautilus_file_forget_scaled_thumbnails (file);
 	if (file->details->thumbnail) {
 		g_object_unref (file->details->thumbnail);
 	}
@@ -827,9 +1016,7 @@ finalize (GObject *object)
 		g_hash_table_destroy (file->details->extension_attributes);
 	}
 
-	if (file->details->metadata) {
-		metadata_hash_free (file->details->metadata);
-	}
+	metadata_free (file->details->metadata);
 
 	G_OBJECT_CLASS (nautilus_file_parent_class)->finalize (object);
 }
@@ -2945,6 +3132,8 @@ compare_by_type (NautilusFile *file_1, NautilusFile *file_2)
 {
 	gboolean is_directory_1;
 	gboolean is_directory_2;
+	const char *key_1;
+	const char *key_2;
 	char *type_string_1;
 	char *type_string_2;
 	int result;
@@ -2952,7 +3141,8 @@ compare_by_type (NautilusFile *file_1, NautilusFile *file_2)
 	/* Directories go first. Then, if mime types are identical,
 	 * don't bother getting strings (for speed). This assumes
 	 * that the string is dependent entirely on the mime type,
-	 * which is true now but might not be later.
+	 * which is true now but might not be later. Mime types are
+	 * interned, so comparing the pointers is enough.
 	 */
 	is_directory_1 = nautilus_file_is_directory (file_1);
 	is_directory_2 = nautilus_file_is_directory (file_2);
@@ -2970,12 +3160,16 @@ compare_by_type (NautilusFile *file_1, NautilusFile *file_2)
 	}
 
 	if (file_1->details->mime_type != NULL &&
-	    file_2->details->mime_type != NULL &&
-	    strcmp (eel_ref_str_peek (file_1->details->mime_type),
-		    eel_ref_str_peek (file_2->details->mime_type)) == 0) {
+	    file_1->details->mime_type == file_2->details->mime_type) {
 		return 0;
 	}
 
+	key_1 = peek_type_collation_key (file_1);
+	key_2 = peek_type_collation_key (file_2);
+	if (key_1 != NULL && key_2 != NULL) {
+		return strcmp (key_1, key_2);
+	}
+
 	type_string_1 = nautilus_file_get_type_as_string (file_1);
 	type_string_2 = nautilus_file_get_type_as_string (file_2);
 
@@ -3455,7 +3649,7 @@ nautilus_file_get_metadata (NautilusFile *file,
 	g_return_val_if_fail (NAUTILUS_IS_FILE (file), g_strdup (default_metadata));
 
 	id = nautilus_metadata_get_id (key);
-	value = g_hash_table_lookup (file->details->metadata, GUINT_TO_POINTER (id));
+	value = metadata_lookup (file->details->metadata, id);
 
 	if (value) {
 		return g_strdup (value);
@@ -3485,7 +3679,7 @@ nautilus_file_get_metadata_list (NautilusFile *file,
 	id = nautilus_metadata_get_id (key);
 	id |= METADATA_ID_IS_LIST_MASK;
 
-	value = g_hash_table_lookup (file->details->metadata, GUINT_TO_POINTER (id));
+	value = metadata_lookup (file->details->metadata, id);
 
 	if (value) {
 		res = NULL;
@@ -4227,6 +4421,114 @@ nautilus_file_get_thumbnail_path (NautilusFile *file)
 	return g_strdup (file->details->thumbnail_path);
 }
 
+/* Scaling and framing a thumbnail is expensive, and views ask for the
+ * same icons on every redraw, so the results are kept in a global LRU
+ * bounded by SCALED_THUMBNAIL_CACHE_BUDGET. Each file also lists its
+ * own entries so they can be dropped when its thumbnail changes.
+ */
+typedef struct {
+	NautilusFile *file;
+	GdkPixbuf *source;
+	int width;
+	int height;
+	NautilusIconInfo *icon;
+	gsize bytes;
+	GList lru_link;
+} ScaledThumbnail;
+
+static GQueue scaled_thumbnail_lru = G_QUEUE_INIT;
+static gsize scaled_thumbnail_bytes;
+static guint64 scaled_thumbnail_hits;
+static guint64 scaled_thumbnail_misses;
+
+static void
+scaled_thumbnail_free (ScaledThumbnail *entry)
+{
+	g_queue_unlink (&scaled_thumbnail_lru, &entry->lru_link);
+	scaled_thumbnail_bytes -= entry->bytes;
+
+	g_object_unref (entry->source);
+	g_object_unref (entry->icon);
+	g_slice_free (ScaledThumbnail, entry);
+}
+
+void
+nautilus_file_forget_scaled_thumbnails (NautilusFile *file)
+{
+	g_list_free_full (file->details->scaled_thumbnails,
+			  (GDestroyNotify) scaled_thumbnail_free);
+	file->details->scaled_thumbnails = NULL;
+}
+
+static NautilusIconInfo *
+lookup_scaled_thumbnail (NautilusFile *file,
+			 int width,
+			 int height)
+{
+	ScaledThumbnail *entry;
+	GList *l;
+
+	for (l = file->details->scaled_thumbnails; l != NULL; l = l->next) {
+		entry = l->data;
+		if (entry->source == file->details->thumbnail &&
+		    entry->width == width &&
+		    entry->height == height) {
+			g_queue_unlink (&scaled_thumbnail_lru, &entry->lru_link);
+			g_queue_push_head_link (&scaled_thumbnail_lru, &entry->lru_link);
+
+			scaled_thumbnail_hits++;
+			return g_object_ref (entry->icon);
+		}
+	}
+
+	scaled_thumbnail_misses++;
+	return NULL;
+}
+
+static void
+add_scaled_thumbnail (NautilusFile *file,
+		      GdkPixbuf *source,
+		      int width,
+		      int height,
+		      GdkPixbuf *pixbuf,
+		      NautilusIconInfo *icon)
+{
+	ScaledThumbnail *entry, *oldest;
+	guint evicted;
+
+	entry = g_slice_new0 (ScaledThumbnail);
+	entry->file = file;
+	entry->source = g_object_ref (source);
+	entry->width = width;
+	entry->height = height;
+	entry->icon = g_object_ref (icon);
+	entry->bytes = gdk_pixbuf_get_rowstride (pixbuf) * gdk_pixbuf_get_height (pixbuf);
+	entry->lru_link.data = entry;
+
+	g_queue_push_head_link (&scaled_thumbnail_lru, &entry->lru_link);
+	scaled_thumbnail_bytes += entry->bytes;
+	file->details->scaled_thumbnails =
+		g_list_prepend (file->details->scaled_thumbnails, entry);
+
+	/* Evict the least recently used, but always keep the new one */
+	evicted = 0;
+	while (scaled_thumbnail_bytes > SCALED_THUMBNAIL_CACHE_BUDGET &&
+	       scaled_thumbnail_lru.tail != &entry->lru_link) {
+		oldest = scaled_thumbnail_lru.tail->data;
+		oldest->file->details->scaled_thumbnails =
+			g_list_remove (oldest->file->details->scaled_thumbnails, oldest);
+		scaled_thumbnail_free (oldest);
+		evicted++;
+	}
+
+	if (evicted > 0) {
+		DEBUG ("Evicted %u scaled thumbnails, cache at %" G_GSIZE_FORMAT " bytes, "
+		       "%" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT " misses",
+		       evicted, scaled_thumbnail_bytes,
+		       scaled_thumbnail_hits, scaled_thumbnail_misses);
+	}
+}
+
 NautilusIconInfo *
 nautilus_file_get_icon (NautilusFile *file,
 			int size,
@@ -4270,6 +4572,8 @@ nautilus_file_get_icon (NautilusFile *file,
 			int w, h, s;
 			double scale;
 
+			int scaled_w, scaled_h;
+
 			raw_pixbuf = g_object_ref (file->details->thumbnail);
 
 			w = gdk_pixbuf_get_width (raw_pixbuf);
@@ -4288,17 +4592,8 @@ nautilus_file_get_icon (NautilusFile *file,
 				scale = (double) NAUTILUS_ICON_SIZE_SMALLEST / s;
 			}
 
-			scaled_pixbuf = gdk_pixbuf_scale_simple (raw_pixbuf,
-								 MAX (w * scale, 1),
-								 MAX (h * scale, 1),
-								 GDK_INTERP_BILINEAR);
-
-			/* We don't want frames around small icons */
-			if (!gdk_pixbuf_get_has_alpha (raw_pixbuf) || s >= 128) {
-				nautilus_ui_frame_image (&scaled_pixbuf);
-			}
-
-			g_object_unref (raw_pixbuf);
+			scaled_w = MAX (w * scale, 1);
+			scaled_h = MAX (h * scale, 1);
 
 			/* Don't scale up if more than 25%, then read the original
 			   image instead. We don't want to compare to exactly 100%,
@@ -4312,10 +4607,28 @@ nautilus_file_get_icon (NautilusFile *file,
 				nautilus_file_invalidate_attributes (file, NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL);
 			}
 
+			icon = lookup_scaled_thumbnail (file, scaled_w, scaled_h);
+			if (icon != NULL) {
+				g_object_unref (raw_pixbuf);
+				return icon;
+			}
+
+			scaled_pixbuf = gdk_pixbuf_scale_simple (raw_pixbuf,
+								 scaled_w,
+								 scaled_h,
+								 GDK_INTERP_BILINEAR);
+
+			/* We don't want frames around small icons */
+			if (!gdk_pixbuf_get_has_alpha (raw_pixbuf) || s >= 128) {
+				nautilus_ui_frame_image (&scaled_pixbuf);
+			}
+
 			DEBUG ("Returning thumbnailed image, at size %d %d",
-			       (int) (w * scale), (int) (h * scale));
+			       scaled_w, scaled_h);
 			
 			icon = nautilus_icon_info_new_for_pixbuf (scaled_pixbuf);
+			add_scaled_thumbnail (file, raw_pixbuf, scaled_w, scaled_h, scaled_pixbuf, icon);
+			g_object_unref (raw_pixbuf);
 			g_object_unref (scaled_pixbuf);
 			return icon;
 		} else if (file->details->thumbnail_path == NULL &&
@@ -6205,11 +6518,92 @@ get_basic_type_for_mime_type (const char *mime_type)
 	return basic_type;
 }
 
+/* Type descriptions depend only on the mime type, but computing them
+ * goes through the shared mime database and allocates. Sort comparators
+ * and the Type column ask for them over and over, so keep one record per
+ * interned mime type until the mime database changes.
+ */
+typedef struct {
+	char *basic;
+	char *basic_collation_key;
+	char *detailed;
+} TypeDescription;
+
+static GHashTable *type_descriptions = NULL;
+
+static void
+type_description_free (TypeDescription *description)
+{
+	g_free (description->basic);
+	g_free (description->basic_collation_key);
+	g_free (description->detailed);
+	g_slice_free (TypeDescription, description);
+}
+
+static void
+type_descriptions_clear (void)
+{
+	if (type_descriptions != NULL) {
+		g_hash_table_destroy (type_descriptions);
+		type_descriptions = NULL;
+	}
+}
+
+/* mime_type must come from eel_ref_str_get_unique, so that the pointer
+ * itself can be used as the key.
+ */
+static TypeDescription *
+lookup_type_description (eel_ref_str mime_type)
+{
+	TypeDescription *description;
+
+	if (type_descriptions == NULL) {
+		type_descriptions = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+							   (GDestroyNotify) eel_ref_str_unref,
+							   (GDestroyNotify) type_description_free);
+	}
+
+	description = g_hash_table_lookup (type_descriptions, mime_type);
+	if (description == NULL) {
+		description = g_slice_new0 (TypeDescription);
+		description->basic = get_basic_type_for_mime_type (eel_ref_str_peek (mime_type));
+		description->basic_collation_key = g_utf8_collate_key (description->basic, -1);
+		description->detailed = g_content_type_get_description (eel_ref_str_peek (mime_type));
+
+		g_hash_table_insert (type_descriptions,
+				     eel_ref_str_ref (mime_type),
+				     description);
+	}
+
+	return description;
+}
+
+/* Returns the collation key of the string nautilus_file_get_type_as_string
+ * would return, or NULL when that string depends on more than the mime
+ * type and has to be computed the slow way.
+ */
+static const char *
+peek_type_collation_key (NautilusFile *file)
+{
+	const char *mime_type;
+
+	mime_type = eel_ref_str_peek (file->details->mime_type);
+	if (mime_type == NULL ||
+	    nautilus_file_is_symbolic_link (file) ||
+	    g_content_type_is_unknown (mime_type) ||
+	    strcmp (mime_type, "inode/directory") == 0) {
+		return NULL;
+	}
+
+	return lookup_type_description (file->details->mime_type)->basic_collation_key;
+}
+
 static char *
 get_description (NautilusFile *file,
 		 gboolean      detailed)
 {
 	const char *mime_type;
+	TypeDescription *description;
 
 	g_assert (NAUTILUS_IS_FILE (file));
 
@@ -6229,19 +6623,15 @@ get_description (NautilusFile *file,
 		return g_strdup (_("Folder"));
 	}
 
-	if (detailed) {
-		char *description;
+	description = lookup_type_description (file->details->mime_type);
 
-		description = g_content_type_get_description (mime_type);
-		if (description != NULL) {
-			return description;
+	if (detailed) {
+		if (description->detailed != NULL) {
+			return g_strdup (description->detailed);
 		}
 	} else {
-		char *category;
-
-		category = get_basic_type_for_mime_type (mime_type);
-		if (category != NULL) {
-			return category;
+		if (description->basic != NULL) {
+			return g_strdup (description->basic);
 		}
 	}
 
@@ -7322,6 +7712,184 @@ invalidate_mount (NautilusFile *file)
 	file->details->mount_is_up_to_date = FALSE;
 }
 
+/* What the info providers said about a file, so that showing it again
+ * doesn't mean asking them again as long as the file didn't change.
+ */
+#define EXTENSION_INFO_CACHE_SIZE 50000
+
+typedef struct {
+	char *uri;
+	time_t mtime;
+	GList *emblems;
+	GHashTable *attributes;
+	GList *link; /* in extension_info_lru */
+} ExtensionInfoCacheEntry;
+
+static GHashTable *extension_info_cache; /* uri -> ExtensionInfoCacheEntry */
+static GQueue extension_info_lru = G_QUEUE_INIT; /* most recently used first */
+
+static GHashTable *
+extension_attributes_copy (GHashTable *attributes)
+{
+	GHashTable *copy;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (attributes == NULL) {
+		return NULL;
+	}
+
+	copy = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+				      NULL,
+				      (GDestroyNotify)g_free);
+	g_hash_table_iter_init (&iter, attributes);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		g_hash_table_insert (copy, key, g_strdup (value));
+	}
+
+	return copy;
+}
+
+static void
+extension_info_cache_entry_free (ExtensionInfoCacheEntry *entry)
+{
+	g_queue_delete_link (&extension_info_lru, entry->link);
+	g_list_free_full (entry->emblems, g_free);
+	if (entry->attributes) {
+		g_hash_table_destroy (entry->attributes);
+	}
+	g_free (entry->uri);
+	g_slice_free (ExtensionInfoCacheEntry, entry);
+}
+
+static void
+extension_info_cache_store (NautilusFile *file)
+{
+	ExtensionInfoCacheEntry *entry;
+
+	if (!file->details->got_file_info ||
+	    file->details->mtime == 0) {
+		return;
+	}
+
+	if (extension_info_cache == NULL) {
+		extension_info_cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+							      (GDestroyNotify) extension_info_cache_entry_free);
+	}
+
+	entry = g_slice_new0 (ExtensionInfoCacheEntry);
+	entry->uri = nautilus_file_get_uri (file);
+	entry->mtime = file->details->mtime;
+	entry->emblems = g_list_copy_deep (file->details->extension_emblems,
+					   (GCopyFunc) g_strdup, NULL);
+	entry->attributes = extension_attributes_copy (file->details->extension_attributes);
+	g_queue_push_head (&extension_info_lru, entry);
+	entry->link = extension_info_lru.head;
+
+	g_hash_table_replace (extension_info_cache, entry->uri, entry);
+
+	while (g_queue_get_length (&extension_info_lru) > EXTENSION_INFO_CACHE_SIZE) {
+		entry = g_queue_peek_tail (&extension_info_lru);
+		g_hash_table_remove (extension_info_cache, entry->uri);
+	}
+}
+
+/* Makes the info providers run on the file again even if it didn't
+ * change, as a reload asks for.
+ */
+void
+nautilus_file_forget_extension_info (NautilusFile *file)
+{
+	char *uri;
+
+	if (extension_info_cache == NULL) {
+		return;
+	}
+
+	uri = nautilus_file_get_uri (file);
+	g_hash_table_remove (extension_info_cache, uri);
+	g_free (uri);
+}
+
+static ExtensionInfoCacheEntry *
+extension_info_cache_lookup (NautilusFile *file)
+{
+	ExtensionInfoCacheEntry *entry;
+	char *uri;
+
+	if (file->details->extension_info_cache_checked ||
+	    !file->details->file_info_is_up_to_date ||
+	    !file->details->got_file_info ||
+	    extension_info_cache == NULL) {
+		return NULL;
+	}
+
+	uri = nautilus_file_get_uri (file);
+	entry = g_hash_table_lookup (extension_info_cache, uri);
+	g_free (uri);
+
+	if (entry == NULL || entry->mtime != file->details->mtime) {
+		return NULL;
+	}
+
+	return entry;
+}
+
+/* Whether nautilus_file_restore_extension_info() would succeed,
+ * without changing anything.
+ */
+gboolean
+nautilus_file_can_restore_extension_info (NautilusFile *file)
+{
+	return extension_info_cache_lookup (file) != NULL;
+}
+
+/* Sets the extension info from the cache instead of running the info
+ * providers, if the file didn't change since they last ran on it.
+ */
+gboolean
+nautilus_file_restore_extension_info (NautilusFile *file)
+{
+	ExtensionInfoCacheEntry *entry;
+
+	if (!file->details->file_info_is_up_to_date) {
+		return FALSE;
+	}
+
+	entry = extension_info_cache_lookup (file);
+	file->details->extension_info_cache_checked = TRUE;
+
+	if (entry == NULL) {
+		return FALSE;
+	}
+
+	g_queue_unlink (&extension_info_lru, entry->link);
+	g_queue_push_head_link (&extension_info_lru, entry->link);
+
+	g_list_free_full (file->details->pending_info_providers, g_object_unref);
+	file->details->pending_info_providers = NULL;
+
+	g_list_free_full (file->details->pending_extension_emblems, g_free);
+	file->details->pending_extension_emblems = NULL;
+	if (file->details->pending_extension_attributes) {
+		g_hash_table_destroy (file->details->pending_extension_attributes);
+		file->details->pending_extension_attributes = NULL;
+	}
+
+	g_list_free_full (file->details->extension_emblems, g_free);
+	file->details->extension_emblems =
+		g_list_copy_deep (entry->emblems, (GCopyFunc) g_strdup, NULL);
+	if (file->details->extension_attributes) {
+		g_hash_table_destroy (file->details->extension_attributes);
+	}
+	file->details->extension_attributes =
+		extension_attributes_copy (entry->attributes);
+
+	nautilus_file_changed (file);
+
+	return TRUE;
+}
+
 void
 nautilus_file_invalidate_extension_info_internal (NautilusFile *file)
 {
@@ -7330,6 +7898,7 @@ nautilus_file_invalidate_extension_info_internal (NautilusFile *file)
 
 	file->details->pending_info_providers =
 		nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_INFO_PROVIDER);
+	file->details->extension_info_cache_checked = FALSE;
 }
 
 void
@@ -7709,6 +8278,48 @@ nautilus_file_list_sort_by_display_name (GList *list)
 	return g_list_sort (list, compare_by_display_name_cover);
 }
 
+/**
+ * nautilus_file_list_preload_icons
+ *
+ * Start loading the icons for the distinct mime types in @list
+ * in the background, so they are cached by the time the files
+ * are displayed.
+ * @list: GList of files.
+ * @size: the icon size the files will be displayed at.
+ **/
+void
+nautilus_file_list_preload_icons (GList *list,
+				  int size)
+{
+	GHashTable *seen_types;
+	GList *icons, *l;
+	NautilusFile *file;
+	const char *mime_type;
+
+	/* Mime types are interned, so the pointer identifies them */
+	seen_types = g_hash_table_new (NULL, NULL);
+	icons = NULL;
+
+	for (l = list; l != NULL; l = l->next) {
+		file = NAUTILUS_FILE (l->data);
+		mime_type = eel_ref_str_peek (file->details->mime_type);
+		if (mime_type == NULL ||
+		    g_hash_table_contains (seen_types, mime_type)) {
+			continue;
+		}
+
+		g_hash_table_add (seen_types, (gpointer) mime_type);
+		icons = g_list_prepend (icons, g_content_type_get_icon (mime_type));
+	}
+
+	if (icons != NULL) {
+		nautilus_icon_info_preload_async (icons, size, NULL, NULL, NULL);
+	}
+
+	g_list_free_full (icons, g_object_unref);
+	g_hash_table_destroy (seen_types);
+}
+
 static GList *ready_data_list = NULL;
 
 typedef struct 
@@ -7999,6 +8610,9 @@ show_thumbnails_changed_callback (gpointer user_data)
 static void
 mime_type_data_changed_callback (GObject *signaller, gpointer user_data)
 {
+	/* Descriptions come from the mime database, forget the cached ones. */
+	type_descriptions_clear ();
+
 	/* Tell the world that icons might have changed. We could invent a narrower-scope
 	 * signal to mean only "thumbnails might have changed" if this ends up being slow
 	 * for some reason.
@@ -8177,6 +8791,8 @@ nautilus_file_add_string_attribute (NautilusFile *file,
 static void
 nautilus_file_invalidate_extension_info (NautilusFile *file)
 {
+	/* An extension knows better than the mtime */
+	nautilus_file_forget_extension_info (file);
 	nautilus_file_invalidate_attributes (file, NAUTILUS_FILE_ATTRIBUTE_EXTENSION_INFO);
 }
 
@@ -8194,6 +8810,8 @@ nautilus_file_info_providers_done (NautilusFile *file)
 	file->details->extension_attributes = file->details->pending_extension_attributes;
 	file->details->pending_extension_attributes = NULL;
 
+	extension_info_cache_store (file);
+
 	nautilus_file_changed (file);
 }
 
@@ -457,6 +457,8 @@ void                    nautilus_file_list_free                         (GList
 GList *                 nautilus_file_list_copy                         (GList                          *file_list);
 GList *                 nautilus_file_list_from_uris                    (GList                          *uri_list);
 GList *			nautilus_file_list_sort_by_display_name		(GList				*file_list);
+void                    nautilus_file_list_preload_icons                (GList                          *file_list,
+									 int                             size);
 void                    nautilus_file_list_call_when_ready              (GList                          *file_list,
 									 NautilusFileAttributes          attributes,
 									 NautilusFileListHandle        **handle,
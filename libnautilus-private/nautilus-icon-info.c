@@ -31,8 +31,15 @@ struct _NautilusIconInfo
 	GObject parent;
 
 	gboolean sole_owner;
-	gint64 last_use_time;
 	GdkPixbuf *pixbuf;
+
+	/* Set while the icon is in one of the lookup caches */
+	GHashTable *cache;
+	gpointer cache_key;
+	gsize cache_bytes;
+	/* Linked into idle_icons while nobody outside holds the pixbuf */
+	GList lru_link;
+	gboolean idle;
 	
 	gboolean got_embedded_rect;
 	GdkRectangle embedded_rect;
@@ -47,7 +54,9 @@ struct _NautilusIconInfoClass
 	GObjectClass parent_class;
 };
 
-static void schedule_reap_cache (void);
+static void lru_link_idle_icon (NautilusIconInfo *icon);
+static void lru_unlink_idle_icon (NautilusIconInfo *icon);
+static void schedule_trim_cache (void);
 
 G_DEFINE_TYPE (NautilusIconInfo,
 	       nautilus_icon_info,
@@ -56,8 +65,8 @@ G_DEFINE_TYPE (NautilusIconInfo,
 static void
 nautilus_icon_info_init (NautilusIconInfo *icon)
 {
-	icon->last_use_time = g_get_monotonic_time ();
 	icon->sole_owner = TRUE;
+	icon->lru_link.data = icon;
 }
 
 gboolean
@@ -78,8 +87,10 @@ pixbuf_toggle_notify (gpointer      info,
 		g_object_remove_toggle_ref (object,
 					    pixbuf_toggle_notify,
 					    info);
-		icon->last_use_time = g_get_monotonic_time ();
-		schedule_reap_cache ();
+		if (icon->cache != NULL) {
+			lru_link_idle_icon (icon);
+			schedule_trim_cache ();
+		}
 	}
 }
 
@@ -132,7 +143,8 @@ nautilus_icon_info_new_for_pixbuf (GdkPixbuf *pixbuf)
 }
 
 static NautilusIconInfo *
-nautilus_icon_info_new_for_icon_info (GtkIconInfo *icon_info)
+nautilus_icon_info_new_for_icon_info (GtkIconInfo *icon_info,
+				      GdkPixbuf   *pixbuf)
 {
 	NautilusIconInfo *icon;
 	GdkPoint *points;
@@ -142,7 +154,9 @@ nautilus_icon_info_new_for_icon_info (GtkIconInfo *icon_info)
 
 	icon = g_object_new (NAUTILUS_TYPE_ICON_INFO, NULL);
 
-	icon->pixbuf = gtk_icon_info_load_icon (icon_info, NULL);
+	if (pixbuf) {
+		icon->pixbuf = g_object_ref (pixbuf);
+	}
 
 	icon->got_embedded_rect = gtk_icon_info_get_embedded_rect (icon_info,
 								   &icon->embedded_rect);
@@ -180,75 +194,139 @@ typedef struct {
 
 static GHashTable *loadable_icon_cache = NULL;
 static GHashTable *themed_icon_cache = NULL;
-static guint reap_cache_timeout = 0;
 
-#define MICROSEC_PER_SEC ((guint64)1000000L)
+/* The caches are bounded by the memory held by their pixbufs. Cached
+ * icons whose pixbuf nobody outside the cache holds are kept in
+ * idle_icons, most recently used first, and are evicted from the tail
+ * once the budget is exceeded. Icons that are still in use are never
+ * evicted, since dropping them would not free anything.
+ */
+#define ICON_CACHE_BUDGET (8 * 1024 * 1024)
 
-static guint time_now;
+static GQueue idle_icons = G_QUEUE_INIT;
+static gsize cached_bytes = 0;
+static guint trim_cache_id = 0;
 
-static gboolean
-reap_old_icon (gpointer  key,
-	       gpointer  value,
-	       gpointer  user_info)
+/* Bumped whenever the caches are cleared, so preloads that were
+ * started against an older icon theme don't repopulate them.
+ */
+static guint cache_generation = 0;
+
+static gsize
+icon_info_get_byte_size (NautilusIconInfo *icon)
 {
-	NautilusIconInfo *icon = value;
-	gboolean *reapable_icons_left = user_info;
+	gsize bytes;
 
-	if (icon->sole_owner) {
-		if (time_now - icon->last_use_time > 30 * MICROSEC_PER_SEC) {
-			/* This went unused 30 secs ago. reap */
-			return TRUE;
-		} else {
-			/* We can reap this soon */
-			*reapable_icons_left = TRUE;
-		}
+	bytes = sizeof (NautilusIconInfo);
+	if (icon->pixbuf != NULL) {
+		bytes += gdk_pixbuf_get_byte_length (icon->pixbuf);
 	}
-	
-	return FALSE;
+
+	return bytes;
 }
 
-static gboolean
-reap_cache (gpointer data)
+static void
+lru_unlink_idle_icon (NautilusIconInfo *icon)
 {
-	gboolean reapable_icons_left;
+	if (icon->idle) {
+		g_queue_unlink (&idle_icons, &icon->lru_link);
+		icon->idle = FALSE;
+	}
+}
 
-	reapable_icons_left = TRUE;
+static void
+lru_link_idle_icon (NautilusIconInfo *icon)
+{
+	lru_unlink_idle_icon (icon);
+	g_queue_push_head_link (&idle_icons, &icon->lru_link);
+	icon->idle = TRUE;
+}
 
-	time_now = g_get_monotonic_time ();
-	
-	if (loadable_icon_cache) {
-		g_hash_table_foreach_remove (loadable_icon_cache,
-					     reap_old_icon,
-					     &reapable_icons_left);
+static void
+trim_cache (void)
+{
+	NautilusIconInfo *icon;
+
+	while (cached_bytes > ICON_CACHE_BUDGET &&
+	       idle_icons.tail != NULL) {
+		icon = idle_icons.tail->data;
+		/* Unlinks the icon and drops the cache reference,
+		 * see icon_cache_value_free().
+		 */
+		g_hash_table_remove (icon->cache, icon->cache_key);
 	}
-	
-	if (themed_icon_cache) {
-		g_hash_table_foreach_remove (themed_icon_cache,
-					     reap_old_icon,
-					     &reapable_icons_left);
+}
+
+static gboolean
+trim_cache_idle (gpointer data)
+{
+	trim_cache_id = 0;
+	trim_cache ();
+
+	return FALSE;
+}
+
+/* Eviction may finalize icons, so it is never done synchronously from
+ * lookups or from the pixbuf toggle notification.
+ */
+static void
+schedule_trim_cache (void)
+{
+	if (trim_cache_id == 0 && cached_bytes > ICON_CACHE_BUDGET) {
+		trim_cache_id = g_idle_add (trim_cache_idle, NULL);
 	}
-	
-	if (reapable_icons_left) {
-		return TRUE;
-	} else {
-		reap_cache_timeout = 0;
-		return FALSE;
+}
+
+static void
+icon_cache_value_free (NautilusIconInfo *icon)
+{
+	lru_unlink_idle_icon (icon);
+	cached_bytes -= icon->cache_bytes;
+	icon->cache = NULL;
+	icon->cache_key = NULL;
+	icon->cache_bytes = 0;
+
+	g_object_unref (icon);
+}
+
+static NautilusIconInfo *
+icon_cache_lookup (GHashTable    *cache,
+		   gconstpointer  key)
+{
+	NautilusIconInfo *icon;
+
+	icon = g_hash_table_lookup (cache, key);
+	if (icon != NULL && icon->idle) {
+		lru_link_idle_icon (icon);
 	}
+
+	return icon;
 }
 
+/* Takes over the reference to @icon */
 static void
-schedule_reap_cache (void)
+icon_cache_insert (GHashTable       *cache,
+		   gpointer          key,
+		   NautilusIconInfo *icon)
 {
-	if (reap_cache_timeout == 0) {
-		reap_cache_timeout = g_timeout_add_seconds_full (0, 5,
-								 reap_cache,
-								 NULL, NULL);
+	icon->cache = cache;
+	icon->cache_key = key;
+	icon->cache_bytes = icon_info_get_byte_size (icon);
+	cached_bytes += icon->cache_bytes;
+
+	g_hash_table_insert (cache, key, icon);
+
+	if (icon->sole_owner) {
+		lru_link_idle_icon (icon);
 	}
+	schedule_trim_cache ();
 }
 
 void
 nautilus_icon_info_clear_caches (void)
 {
+	cache_generation++;
+
 	if (loadable_icon_cache) {
 		g_hash_table_remove_all (loadable_icon_cache);
 	}
@@ -324,102 +402,136 @@ themed_icon_key_free (ThemedIconKey *key)
 	g_slice_free (ThemedIconKey, key);
 }
 
+static void
+ensure_caches (void)
+{
+	if (loadable_icon_cache == NULL) {
+		loadable_icon_cache =
+			g_hash_table_new_full ((GHashFunc)loadable_icon_key_hash,
+					       (GEqualFunc)loadable_icon_key_equal,
+					       (GDestroyNotify) loadable_icon_key_free,
+					       (GDestroyNotify) icon_cache_value_free);
+	}
+
+	if (themed_icon_cache == NULL) {
+		themed_icon_cache =
+			g_hash_table_new_full ((GHashFunc)themed_icon_key_hash,
+					       (GEqualFunc)themed_icon_key_equal,
+					       (GDestroyNotify) themed_icon_key_free,
+					       (GDestroyNotify) icon_cache_value_free);
+	}
+}
+
+/* Safe to call from a worker thread */
+static GdkPixbuf *
+load_loadable_icon (GLoadableIcon *icon,
+		    int            size,
+		    GCancellable  *cancellable)
+{
+	GInputStream *stream;
+	GdkPixbuf *pixbuf;
+
+	pixbuf = NULL;
+	stream = g_loadable_icon_load (icon, size,
+				       NULL, cancellable, NULL);
+	if (stream) {
+		pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
+							      size, size, TRUE,
+							      cancellable, NULL);
+		g_input_stream_close (stream, NULL, NULL);
+		g_object_unref (stream);
+	}
+
+	return pixbuf;
+}
+
+/* Returns a GtkIconInfo that has a backing file, or NULL */
+static GtkIconInfo *
+choose_themed_icon (GThemedIcon *icon,
+		    int          size)
+{
+	const char * const *names;
+	GtkIconInfo *gtkicon_info;
+
+	names = g_themed_icon_get_names (icon);
+	gtkicon_info = gtk_icon_theme_choose_icon (gtk_icon_theme_get_default (),
+						   (const char **)names, size, 0);
+
+	if (gtkicon_info != NULL &&
+	    gtk_icon_info_get_filename (gtkicon_info) == NULL) {
+		g_object_unref (gtkicon_info);
+		gtkicon_info = NULL;
+	}
+
+	return gtkicon_info;
+}
+
 NautilusIconInfo *
 nautilus_icon_info_lookup (GIcon *icon,
 			   int size)
 {
 	NautilusIconInfo *icon_info;
 	GdkPixbuf *pixbuf;
-	
+
+	ensure_caches ();
+
 	if (G_IS_LOADABLE_ICON (icon)) {
 		LoadableIconKey lookup_key;
-		LoadableIconKey *key;
-		GInputStream *stream;
-		
-		if (loadable_icon_cache == NULL) {
-			loadable_icon_cache =
-				g_hash_table_new_full ((GHashFunc)loadable_icon_key_hash,
-						       (GEqualFunc)loadable_icon_key_equal,
-						       (GDestroyNotify) loadable_icon_key_free,
-						       (GDestroyNotify) g_object_unref);
-		}
 		
 		lookup_key.icon = icon;
 		lookup_key.size = size;
 
-		icon_info = g_hash_table_lookup (loadable_icon_cache, &lookup_key);
+		icon_info = icon_cache_lookup (loadable_icon_cache, &lookup_key);
 		if (icon_info) {
 			return g_object_ref (icon_info);
 		}
 
-		pixbuf = NULL;
-		stream = g_loadable_icon_load (G_LOADABLE_ICON (icon),
-					       size,
-					       NULL, NULL, NULL);
-		if (stream) {
-			pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
-								      size, size, TRUE,
-								      NULL, NULL);
-			g_input_stream_close (stream, NULL, NULL);
-			g_object_unref (stream);
-		}
-
+		pixbuf = load_loadable_icon (G_LOADABLE_ICON (icon), size, NULL);
 		icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf);
+		if (pixbuf != NULL) {
+			g_object_unref (pixbuf);
+		}
 
-		key = loadable_icon_key_new (icon, size);
-		g_hash_table_insert (loadable_icon_cache, key, icon_info);
+		icon_cache_insert (loadable_icon_cache,
+				   loadable_icon_key_new (icon, size),
+				   g_object_ref (icon_info));
 
-		return g_object_ref (icon_info);
+		return icon_info;
 	} else if (G_IS_THEMED_ICON (icon)) {
-		const char * const *names;
 		ThemedIconKey lookup_key;
-		ThemedIconKey *key;
-		GtkIconTheme *icon_theme;
 		GtkIconInfo *gtkicon_info;
 		const char *filename;
 
-		if (themed_icon_cache == NULL) {
-			themed_icon_cache =
-				g_hash_table_new_full ((GHashFunc)themed_icon_key_hash,
-						       (GEqualFunc)themed_icon_key_equal,
-						       (GDestroyNotify) themed_icon_key_free,
-						       (GDestroyNotify) g_object_unref);
-		}
-		
-		names = g_themed_icon_get_names (G_THEMED_ICON (icon));
-
-		icon_theme = gtk_icon_theme_get_default ();
-		gtkicon_info = gtk_icon_theme_choose_icon (icon_theme, (const char **)names, size, 0);
-
+		gtkicon_info = choose_themed_icon (G_THEMED_ICON (icon), size);
 		if (gtkicon_info == NULL) {
 			return nautilus_icon_info_new_for_pixbuf (NULL);
 		}
 
 		filename = gtk_icon_info_get_filename (gtkicon_info);
-		if (filename == NULL) {
-			g_object_unref (gtkicon_info);
-			return nautilus_icon_info_new_for_pixbuf (NULL);
-		}
 
 		lookup_key.filename = (char *)filename;
 		lookup_key.size = size;
 
-		icon_info = g_hash_table_lookup (themed_icon_cache, &lookup_key);
+		icon_info = icon_cache_lookup (themed_icon_cache, &lookup_key);
 		if (icon_info) {
 			g_object_unref (gtkicon_info);
 			return g_object_ref (icon_info);
 		}
-		
-		icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info);
-		
-		key = themed_icon_key_new (filename, size);
-		g_hash_table_insert (themed_icon_cache, key, icon_info);
+
+		pixbuf = gtk_icon_info_load_icon (gtkicon_info, NULL);
+		icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info, pixbuf);
+		if (pixbuf != NULL) {
+			g_object_unref (pixbuf);
+		}
+
+		icon_cache_insert (themed_icon_cache,
+				   themed_icon_key_new (filename, size),
+				   g_object_ref (icon_info));
 
 		g_object_unref (gtkicon_info);
 
-		return g_object_ref (icon_info);
+		return icon_info;
 	} else {
-                GdkPixbuf *pixbuf;
                 GtkIconInfo *gtk_icon_info;
 
                 gtk_icon_info = gtk_icon_theme_lookup_by_gicon (gtk_icon_theme_get_default (),
@@ -443,6 +555,243 @@ nautilus_icon_info_lookup (GIcon *icon,
         }
 }
 
+typedef struct {
+	GList *icons;
+	int size;
+	guint generation;
+	/* Loads started and not finished yet */
+	int pending;
+	GCancellable *cancellable;
+	GTask *task;
+} PreloadData;
+
+typedef struct {
+	PreloadData *data;
+	GIcon *icon;
+	GdkPixbuf *pixbuf;
+} PreloadIcon;
+
+static void
+preload_data_unref_pending (PreloadData *data)
+{
+	if (--data->pending > 0 || data->icons != NULL) {
+		return;
+	}
+
+	g_task_return_boolean (data->task, TRUE);
+	g_object_unref (data->task);
+	g_clear_object (&data->cancellable);
+	g_slice_free (PreloadData, data);
+}
+
+static gboolean
+preload_is_current (PreloadData *data)
+{
+	return data->generation == cache_generation &&
+		!g_cancellable_is_cancelled (data->cancellable);
+}
+
+static void
+preload_themed_done (GObject      *source_object,
+		     GAsyncResult *res,
+		     gpointer      user_data)
+{
+	PreloadData *data = user_data;
+	GtkIconInfo *gtkicon_info;
+	NautilusIconInfo *icon_info;
+	ThemedIconKey themed_key;
+	GdkPixbuf *pixbuf;
+
+	gtkicon_info = GTK_ICON_INFO (source_object);
+	pixbuf = gtk_icon_info_load_icon_finish (gtkicon_info, res, NULL);
+
+	if (preload_is_current (data)) {
+		/* The icon may have been looked up while it was loading */
+		ensure_caches ();
+		themed_key.filename = (char *)gtk_icon_info_get_filename (gtkicon_info);
+		themed_key.size = data->size;
+		if (g_hash_table_lookup (themed_icon_cache, &themed_key) == NULL) {
+			icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info, pixbuf);
+			icon_cache_insert (themed_icon_cache,
+					   themed_icon_key_new (themed_key.filename, data->size),
+					   icon_info);
+		}
+	}
+
+	g_clear_object (&pixbuf);
+	g_object_unref (gtkicon_info);
+	preload_data_unref_pending (data);
+}
+
+static void
+preload_loadable_thread_func (GTask        *task,
+			      gpointer      source,
+			      gpointer      task_data,
+			      GCancellable *cancellable)
+{
+	PreloadIcon *preload = task_data;
+
+	preload->pixbuf = load_loadable_icon (G_LOADABLE_ICON (preload->icon),
+					      preload->data->size,
+					      cancellable);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static void
+preload_loadable_done (GObject      *source_object,
+		       GAsyncResult *res,
+		       gpointer      user_data)
+{
+	PreloadIcon *preload;
+	PreloadData *data;
+	NautilusIconInfo *icon_info;
+	LoadableIconKey loadable_key;
+
+	preload = g_task_get_task_data (G_TASK (res));
+	data = preload->data;
+
+	if (preload_is_current (data)) {
+		ensure_caches ();
+		loadable_key.icon = preload->icon;
+		loadable_key.size = data->size;
+		if (g_hash_table_lookup (loadable_icon_cache, &loadable_key) == NULL) {
+			icon_info = nautilus_icon_info_new_for_pixbuf (preload->pixbuf);
+			icon_cache_insert (loadable_icon_cache,
+					   loadable_icon_key_new (preload->icon, data->size),
+					   icon_info);
+		}
+	}
+
+	g_object_unref (preload->icon);
+	g_clear_object (&preload->pixbuf);
+	g_slice_free (PreloadIcon, preload);
+	preload_data_unref_pending (data);
+}
+
+/* Resolves one icon per call, so the theme lookups don't hold up
+ * the main loop either. Themed icons are decoded with
+ * gtk_icon_info_load_icon_async(), which works on its own copy of the
+ * GtkIconInfo; those are shared with the main thread through the
+ * theme's cache.
+ */
+static gboolean
+preload_idle_callback (gpointer user_data)
+{
+	PreloadData *data = user_data;
+	PreloadIcon *preload;
+	LoadableIconKey loadable_key;
+	ThemedIconKey themed_key;
+	GtkIconInfo *gtkicon_info;
+	GTask *thread_task;
+	GIcon *icon;
+
+	if (!preload_is_current (data)) {
+		g_list_free_full (data->icons, g_object_unref);
+		data->icons = NULL;
+		preload_data_unref_pending (data);
+		return FALSE;
+	}
+
+	ensure_caches ();
+
+	icon = data->icons->data;
+	data->icons = g_list_delete_link (data->icons, data->icons);
+
+	if (G_IS_LOADABLE_ICON (icon)) {
+		loadable_key.icon = icon;
+		loadable_key.size = data->size;
+		if (g_hash_table_lookup (loadable_icon_cache, &loadable_key) == NULL) {
+			preload = g_slice_new0 (PreloadIcon);
+			preload->data = data;
+			preload->icon = g_object_ref (icon);
+
+			data->pending++;
+			thread_task = g_task_new (NULL, data->cancellable,
+						  preload_loadable_done, NULL);
+			g_task_set_task_data (thread_task, preload, NULL);
+			g_task_run_in_thread (thread_task, preload_loadable_thread_func);
+			g_object_unref (thread_task);
+		}
+	} else if (G_IS_THEMED_ICON (icon)) {
+		gtkicon_info = choose_themed_icon (G_THEMED_ICON (icon), data->size);
+		if (gtkicon_info != NULL) {
+			themed_key.filename = (char *)gtk_icon_info_get_filename (gtkicon_info);
+			themed_key.size = data->size;
+			if (g_hash_table_lookup (themed_icon_cache, &themed_key) == NULL) {
+				data->pending++;
+				gtk_icon_info_load_icon_async (gtkicon_info, data->cancellable,
+							       preload_themed_done, data);
+			} else {
+				g_object_unref (gtkicon_info);
+			}
+		}
+	}
+	/* Other icons are not cached by nautilus_icon_info_lookup() either */
+
+	g_object_unref (icon);
+
+	if (data->icons != NULL) {
+		return TRUE;
+	}
+
+	/* Drops the reference held for the lookups */
+	preload_data_unref_pending (data);
+
+	return FALSE;
+}
+
+/**
+ * nautilus_icon_info_preload_async:
+ * @icons: a list of #GIcon
+ * @size: the size the icons will be looked up at
+ *
+ * Loads the icons in @icons that are not cached yet in the
+ * background and adds them to the cache, so that the following
+ * nautilus_icon_info_lookup() calls don't block on decoding.
+ * Themed icons are resolved against the icon theme from a low
+ * priority idle, one at a time; the decoding happens on worker
+ * threads.
+ **/
+void
+nautilus_icon_info_preload_async (GList               *icons,
+				  int                  size,
+				  GCancellable        *cancellable,
+				  GAsyncReadyCallback  callback,
+				  gpointer             user_data)
+{
+	PreloadData *data;
+	GList *l;
+
+	data = g_slice_new0 (PreloadData);
+	data->size = size;
+	data->generation = cache_generation;
+	data->cancellable = cancellable != NULL ? g_object_ref (cancellable) : g_cancellable_new ();
+	data->task = g_task_new (NULL, cancellable, callback, user_data);
+
+	for (l = icons; l != NULL; l = l->next) {
+		data->icons = g_list_prepend (data->icons, g_object_ref (l->data));
+	}
+	data->icons = g_list_reverse (data->icons);
+
+	/* One pending reference for the lookups in the idle */
+	data->pending = 1;
+
+	if (data->icons == NULL) {
+		preload_data_unref_pending (data);
+		return;
+	}
+
+	g_idle_add_full (G_PRIORITY_LOW, preload_idle_callback, data, NULL);
+}
+
+gboolean
+nautilus_icon_info_preload_finish (GAsyncResult  *result,
+				   GError       **error)
+{
+	return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 NautilusIconInfo *
 nautilus_icon_info_lookup_from_name (const char *name,
 				     int size)
@@ -484,6 +833,7 @@ nautilus_icon_info_get_pixbuf_nodefault (NautilusIconInfo  *icon)
 
 		if (icon->sole_owner) {
 			icon->sole_owner = FALSE;
+			lru_unlink_idle_icon (icon);
 			g_object_add_toggle_ref (G_OBJECT (res),
 						 pixbuf_toggle_notify,
 						 icon);
@@ -0,0 +1,482 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-job-scheduler.c: runs file operations per device
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+  
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+  
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-job-scheduler.h"
+
+#include <glib/gi18n.h>
+
+/* How many jobs may run on one device at the same time */
+#define JOBS_PER_DEVICE 1
+
+typedef enum {
+	/* The devices are still being looked up */
+	JOB_RESOLVING,
+	JOB_QUEUED,
+	JOB_RUNNING
+} JobState;
+
+typedef struct {
+	GIOSchedulerJobFunc func;
+	gpointer user_data;
+	NautilusProgressInfo *progress;
+	GCancellable *cancellable;
+	gulong cancelled_id;
+
+	/* Folders of the sources, and the destination */
+	GList *locations;
+	/* Filled in on a thread while resolving */
+	char **devices;
+
+	JobState state;
+	gboolean paused;
+	gboolean announced;
+	/* The progress UI knows about it while it waits */
+	gboolean shown;
+} ScheduledJob;
+
+/* Jobs that didn't start yet, the first one runs first */
+static GQueue waiting_jobs = G_QUEUE_INIT;
+/* Device id -> number of running jobs */
+static GHashTable *busy_devices = NULL;
+static guint dispatch_id = 0;
+
+static void
+scheduled_job_free (ScheduledJob *job)
+{
+	if (job->cancelled_id != 0) {
+		g_signal_handler_disconnect (job->cancellable, job->cancelled_id);
+	}
+	g_object_unref (job->cancellable);
+	g_object_unref (job->progress);
+	g_list_free_full (job->locations, g_object_unref);
+	g_strfreev (job->devices);
+	g_slice_free (ScheduledJob, job);
+}
+
+static char *
+get_device_id (GFile *location,
+	       GCancellable *cancellable)
+{
+	GFileInfo *info;
+	GMount *mount;
+	GFile *root;
+	char *id;
+
+	id = NULL;
+	info = g_file_query_info (location,
+				  G_FILE_ATTRIBUTE_ID_FILESYSTEM,
+				  G_FILE_QUERY_INFO_NONE,
+				  cancellable, NULL);
+	if (info != NULL) {
+		id = g_strdup (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM));
+		g_object_unref (info);
+	}
+	if (id != NULL) {
+		return id;
+	}
+
+	/* Not there yet or not supported, group by mount instead */
+	mount = g_file_find_enclosing_mount (location, cancellable, NULL);
+	if (mount != NULL) {
+		root = g_mount_get_root (mount);
+		id = g_file_get_uri (root);
+		g_object_unref (root);
+		g_object_unref (mount);
+		return id;
+	}
+
+	return g_file_get_uri_scheme (location);
+}
+
+static void
+resolve_devices_thread (GTask *task,
+			gpointer source_object,
+			gpointer task_data,
+			GCancellable *cancellable)
+{
+	ScheduledJob *job = task_data;
+	GPtrArray *devices;
+	GList *l;
+	char *id;
+	guint i;
+
+	devices = g_ptr_array_new ();
+	for (l = job->locations; l != NULL; l = l->next) {
+		id = get_device_id (l->data, cancellable);
+
+		for (i = 0; i < devices->len; i++) {
+			if (g_strcmp0 (id, g_ptr_array_index (devices, i)) == 0) {
+				break;
+			}
+		}
+		if (i < devices->len || id == NULL) {
+			g_free (id);
+		} else {
+			g_ptr_array_add (devices, id);
+		}
+	}
+	g_ptr_array_add (devices, NULL);
+
+	job->devices = (char **) g_ptr_array_free (devices, FALSE);
+
+	g_task_return_boolean (task, TRUE);
+}
+
+static gboolean
+devices_available (ScheduledJob *job,
+		   GHashTable *claimed)
+{
+	int i;
+
+	for (i = 0; job->devices[i] != NULL; i++) {
+		if (GPOINTER_TO_INT (g_hash_table_lookup (busy_devices, job->devices[i])) >= JOBS_PER_DEVICE ||
+		    g_hash_table_contains (claimed, job->devices[i])) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean job_func (GIOSchedulerJob *io_job,
+			  GCancellable *cancellable,
+			  gpointer user_data);
+
+static void
+start_job (ScheduledJob *job)
+{
+	int i, count;
+
+	job->state = JOB_RUNNING;
+
+	/* Lets the progress widget drop its queue buttons right away */
+	if (job->shown) {
+		nautilus_progress_info_set_status (job->progress, _("Starting"));
+		nautilus_progress_info_set_details (job->progress, "");
+	}
+
+	if (job->cancelled_id != 0) {
+		g_signal_handler_disconnect (job->cancellable, job->cancelled_id);
+		job->cancelled_id = 0;
+	}
+
+	for (i = 0; job->devices[i] != NULL; i++) {
+		count = GPOINTER_TO_INT (g_hash_table_lookup (busy_devices, job->devices[i]));
+		g_hash_table_replace (busy_devices, g_strdup (job->devices[i]), GINT_TO_POINTER (count + 1));
+	}
+
+	g_io_scheduler_push_job (job_func,
+				 job,
+				 NULL,
+				 0,
+				 job->cancellable);
+}
+
+static void
+dispatch (void)
+{
+	GHashTable *claimed;
+	ScheduledJob *job;
+	GList *l, *next;
+	int i;
+
+	/* Devices needed by jobs further up the queue, so that later
+	 * jobs on the same device can't overtake them */
+	claimed = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (l = waiting_jobs.head; l != NULL; l = next) {
+		next = l->next;
+		job = l->data;
+
+		if (job->state == JOB_RESOLVING) {
+			continue;
+		}
+
+		/* A cancelled job only cleans up, it can start right away */
+		if (g_cancellable_is_cancelled (job->cancellable) ||
+		    (!job->paused && devices_available (job, claimed))) {
+			g_queue_delete_link (&waiting_jobs, l);
+			start_job (job);
+			continue;
+		}
+
+		if (job->paused) {
+			continue;
+		}
+
+		for (i = 0; job->devices[i] != NULL; i++) {
+			g_hash_table_add (claimed, job->devices[i]);
+		}
+
+		if (!job->announced) {
+			job->announced = TRUE;
+			nautilus_progress_info_set_status (job->progress, _("Waiting"));
+			nautilus_progress_info_set_details (job->progress,
+							    _("Waiting for other operations on the same disk to finish"));
+
+			/* Started early so the progress UI shows the job, and
+			 * its pause and reorder buttons, while it waits. The
+			 * job func starting it again later is a no-op.
+			 */
+			if (!job->shown) {
+				job->shown = TRUE;
+				nautilus_progress_info_start (job->progress);
+			}
+		}
+	}
+
+	g_hash_table_destroy (claimed);
+}
+
+static gboolean
+dispatch_idle (gpointer user_data)
+{
+	dispatch_id = 0;
+	dispatch ();
+
+	return FALSE;
+}
+
+static void
+queue_dispatch (void)
+{
+	if (dispatch_id == 0) {
+		dispatch_id = g_idle_add (dispatch_idle, NULL);
+	}
+}
+
+static gboolean
+job_finished (gpointer user_data)
+{
+	ScheduledJob *job = user_data;
+	int i, count;
+
+	for (i = 0; job->devices[i] != NULL; i++) {
+		count = GPOINTER_TO_INT (g_hash_table_lookup (busy_devices, job->devices[i]));
+		if (count <= 1) {
+			g_hash_table_remove (busy_devices, job->devices[i]);
+		} else {
+			g_hash_table_replace (busy_devices, g_strdup (job->devices[i]), GINT_TO_POINTER (count - 1));
+		}
+	}
+
+	scheduled_job_free (job);
+	dispatch ();
+
+	return FALSE;
+}
+
+static gboolean
+job_func (GIOSchedulerJob *io_job,
+	  GCancellable *cancellable,
+	  gpointer user_data)
+{
+	ScheduledJob *job = user_data;
+
+	if (job->func (io_job, cancellable, job->user_data)) {
+		return TRUE;
+	}
+
+	g_idle_add (job_finished, job);
+
+	return FALSE;
+}
+
+static void
+devices_resolved (GObject *source_object,
+		  GAsyncResult *res,
+		  gpointer user_data)
+{
+	ScheduledJob *job = user_data;
+
+	job->state = JOB_QUEUED;
+	dispatch ();
+}
+
+static void
+job_cancelled (GCancellable *cancellable,
+	       gpointer user_data)
+{
+	queue_dispatch ();
+}
+
+static GList *
+get_locations (GList *sources,
+	       GFile *destination)
+{
+	GHashTable *seen;
+	GList *locations, *l;
+	GFile *location;
+
+	seen = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+	locations = NULL;
+
+	/* Sources mostly share a folder, so only look at each folder once */
+	for (l = sources; l != NULL; l = l->next) {
+		location = g_file_get_parent (l->data);
+		if (location == NULL) {
+			location = g_object_ref (l->data);
+		}
+
+		if (g_hash_table_contains (seen, location)) {
+			g_object_unref (location);
+		} else {
+			g_hash_table_add (seen, location);
+			locations = g_list_prepend (locations, location);
+		}
+	}
+
+	if (destination != NULL &&
+	    !g_hash_table_contains (seen, destination)) {
+		locations = g_list_prepend (locations, g_object_ref (destination));
+	}
+
+	g_hash_table_destroy (seen);
+
+	return g_list_reverse (locations);
+}
+
+void
+nautilus_job_scheduler_push (GIOSchedulerJobFunc job_func,
+			     gpointer user_data,
+			     GList *sources,
+			     GFile *destination,
+			     NautilusProgressInfo *progress)
+{
+	ScheduledJob *job;
+	GTask *task;
+
+	if (busy_devices == NULL) {
+		busy_devices = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	}
+
+	job = g_slice_new0 (ScheduledJob);
+	job->func = job_func;
+	job->user_data = user_data;
+	job->progress = g_object_ref (progress);
+	job->cancellable = nautilus_progress_info_get_cancellable (progress);
+	job->locations = get_locations (sources, destination);
+	job->state = JOB_RESOLVING;
+
+	job->cancelled_id = g_signal_connect (job->cancellable, "cancelled",
+					      G_CALLBACK (job_cancelled), NULL);
+
+	g_queue_push_tail (&waiting_jobs, job);
+
+	task = g_task_new (NULL, NULL, devices_resolved, job);
+	g_task_set_task_data (task, job, NULL);
+	g_task_run_in_thread (task, resolve_devices_thread);
+	g_object_unref (task);
+}
+
+static GList *
+find_waiting_job (NautilusProgressInfo *progress)
+{
+	GList *l;
+	ScheduledJob *job;
+
+	for (l = waiting_jobs.head; l != NULL; l = l->next) {
+		job = l->data;
+		if (job->progress == progress) {
+			return l;
+		}
+	}
+
+	return NULL;
+}
+
+gboolean
+nautilus_job_scheduler_is_queued (NautilusProgressInfo *progress)
+{
+	return find_waiting_job (progress) != NULL;
+}
+
+gboolean
+nautilus_job_scheduler_is_paused (NautilusProgressInfo *progress)
+{
+	GList *link;
+
+	link = find_waiting_job (progress);
+
+	return link != NULL && ((ScheduledJob *) link->data)->paused;
+}
+
+gboolean
+nautilus_job_scheduler_pause (NautilusProgressInfo *progress)
+{
+	GList *link;
+	ScheduledJob *job;
+
+	link = find_waiting_job (progress);
+	if (link == NULL) {
+		return FALSE;
+	}
+
+	job = link->data;
+	if (!job->paused) {
+		job->paused = TRUE;
+		job->announced = FALSE;
+		nautilus_progress_info_set_status (job->progress, _("Paused"));
+		nautilus_progress_info_set_details (job->progress, "");
+
+		/* Jobs behind it may be able to run now */
+		queue_dispatch ();
+	}
+
+	return TRUE;
+}
+
+gboolean
+nautilus_job_scheduler_resume (NautilusProgressInfo *progress)
+{
+	GList *link;
+	ScheduledJob *job;
+
+	link = find_waiting_job (progress);
+	if (link == NULL) {
+		return FALSE;
+	}
+
+	job = link->data;
+	if (job->paused) {
+		job->paused = FALSE;
+		queue_dispatch ();
+	}
+
+	return TRUE;
+}
+
+gboolean
+nautilus_job_scheduler_move_to_front (NautilusProgressInfo *progress)
+{
+	GList *link;
+
+	link = find_waiting_job (progress);
+	if (link == NULL) {
+		return FALSE;
+	}
+
+	g_queue_unlink (&waiting_jobs, link);
+	g_queue_push_head_link (&waiting_jobs, link);
+	queue_dispatch ();
+
+	return TRUE;
+}
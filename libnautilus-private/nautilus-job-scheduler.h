@@ -0,0 +1,47 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-job-scheduler.h: runs file operations per device
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+  
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+  
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_JOB_SCHEDULER_H
+#define NAUTILUS_JOB_SCHEDULER_H
+
+#include <gio/gio.h>
+#include <libnautilus-private/nautilus-progress-info.h>
+
+/* Jobs are grouped by the filesystems of their sources and destination.
+ * A job only starts once no other job is running on any of its
+ * filesystems, so jobs on the same disk run one after the other while
+ * jobs on different disks run in parallel. Queued jobs are identified
+ * by their progress info, as listed by NautilusProgressInfoManager.
+ *
+ * All functions must be called from the main thread.
+ */
+void     nautilus_job_scheduler_push          (GIOSchedulerJobFunc   job_func,
+					       gpointer              user_data,
+					       GList                *sources,
+					       GFile                *destination,
+					       NautilusProgressInfo *progress);
+
+gboolean nautilus_job_scheduler_is_queued     (NautilusProgressInfo *progress);
+gboolean nautilus_job_scheduler_is_paused     (NautilusProgressInfo *progress);
+gboolean nautilus_job_scheduler_pause         (NautilusProgressInfo *progress);
+gboolean nautilus_job_scheduler_resume        (NautilusProgressInfo *progress);
+gboolean nautilus_job_scheduler_move_to_front (NautilusProgressInfo *progress);
+
+#endif /* NAUTILUS_JOB_SCHEDULER_H */
@@ -0,0 +1,319 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-local-copy.c: fast copies between local files
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+  
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+  
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+/* For copy_file_range () and renameat2 () */
+#define _GNU_SOURCE
+
+#include <config.h>
+#include "nautilus-local-copy.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+
+/* Data is moved in chunks this large between progress reports and
+ * cancellation checks.
+ */
+#define KERNEL_COPY_CHUNK (8 * 1024 * 1024)
+#define BUFFER_COPY_SIZE (1024 * 1024)
+#define BUFFER_ALIGNMENT 4096
+
+typedef enum {
+	COPY_METHOD_COPY_FILE_RANGE,
+	COPY_METHOD_SENDFILE,
+	COPY_METHOD_READ_WRITE
+} CopyMethod;
+
+static void
+set_not_supported (GError **error)
+{
+	g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			     _("Operation not supported"));
+}
+
+static void
+set_error_from_errno (GError **error,
+		      int errsv)
+{
+	g_set_error_literal (error, G_IO_ERROR,
+			     g_io_error_from_errno (errsv),
+			     g_strerror (errsv));
+}
+
+/* Whether a failed kernel copy means the method is not available
+ * for this pair of files, rather than an I/O error.
+ */
+static gboolean
+method_unsupported (int errsv)
+{
+	return errsv == ENOSYS || errsv == EXDEV || errsv == EINVAL ||
+		errsv == EOPNOTSUPP || errsv == ENOTSUP;
+}
+
+static gssize
+copy_chunk (int src_fd,
+	    int dest_fd,
+	    CopyMethod *method,
+	    char **buffer)
+{
+	gssize n_read, n_written, res;
+
+	while (TRUE) {
+		switch (*method) {
+		case COPY_METHOD_COPY_FILE_RANGE:
+#ifdef HAVE_COPY_FILE_RANGE
+			res = copy_file_range (src_fd, NULL, dest_fd, NULL,
+					       KERNEL_COPY_CHUNK, 0);
+			if (res >= 0 || !method_unsupported (errno)) {
+				return res;
+			}
+#endif
+			*method = COPY_METHOD_SENDFILE;
+			break;
+		case COPY_METHOD_SENDFILE:
+#if defined (HAVE_SENDFILE) && defined (HAVE_SYS_SENDFILE_H)
+			res = sendfile (dest_fd, src_fd, NULL, KERNEL_COPY_CHUNK);
+			if (res >= 0 || !method_unsupported (errno)) {
+				return res;
+			}
+#endif
+			*method = COPY_METHOD_READ_WRITE;
+			break;
+		case COPY_METHOD_READ_WRITE:
+		default:
+			if (*buffer == NULL &&
+			    posix_memalign ((void **) buffer, BUFFER_ALIGNMENT, BUFFER_COPY_SIZE) != 0) {
+				*buffer = NULL;
+				errno = ENOMEM;
+				return -1;
+			}
+
+			n_read = read (src_fd, *buffer, BUFFER_COPY_SIZE);
+			if (n_read <= 0) {
+				return n_read;
+			}
+
+			for (n_written = 0; n_written < n_read; n_written += res) {
+				res = write (dest_fd, *buffer + n_written, n_read - n_written);
+				if (res < 0 && errno == EINTR) {
+					res = 0;
+				} else if (res < 0) {
+					return -1;
+				}
+			}
+
+			return n_read;
+		}
+	}
+}
+
+/**
+ * nautilus_local_copy_file:
+ *
+ * Copies a regular local file the way g_file_copy() does, but lets the
+ * kernel move the data. The copy is a reflink where the file system
+ * supports it. Otherwise the data goes through copy_file_range() or
+ * sendfile(), with a large aligned buffer as the last resort.
+ *
+ * Fails with %G_IO_ERROR_NOT_SUPPORTED, without touching the
+ * destination, for anything but copying a regular native file to a
+ * new native file. It also fails that way whenever the destination
+ * cannot be created. Callers then use g_file_copy(), which reports
+ * those cases with its usual errors.
+ **/
+gboolean
+nautilus_local_copy_file (GFile *source,
+			  GFile *destination,
+			  GFileCopyFlags flags,
+			  GCancellable *cancellable,
+			  GFileProgressCallback progress_callback,
+			  gpointer progress_callback_data,
+			  GError **error)
+{
+	char *src_path, *dest_path, *buffer;
+	int src_fd, dest_fd, open_flags, errsv;
+	struct stat src_stat;
+	goffset copied;
+	gssize res;
+	CopyMethod method;
+	gboolean success;
+
+	if ((flags & (G_FILE_COPY_OVERWRITE | G_FILE_COPY_BACKUP)) != 0 ||
+	    !g_file_is_native (source) ||
+	    !g_file_is_native (destination)) {
+		set_not_supported (error);
+		return FALSE;
+	}
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		return FALSE;
+	}
+
+	src_path = g_file_get_path (source);
+	dest_path = g_file_get_path (destination);
+	src_fd = -1;
+	dest_fd = -1;
+	buffer = NULL;
+	success = FALSE;
+
+	if (src_path == NULL || dest_path == NULL) {
+		set_not_supported (error);
+		goto out;
+	}
+
+	open_flags = O_RDONLY | O_CLOEXEC;
+	if (flags & G_FILE_COPY_NOFOLLOW_SYMLINKS) {
+		open_flags |= O_NOFOLLOW;
+	}
+
+	src_fd = open (src_path, open_flags);
+	if (src_fd < 0 ||
+	    fstat (src_fd, &src_stat) != 0 ||
+	    !S_ISREG (src_stat.st_mode)) {
+		set_not_supported (error);
+		goto out;
+	}
+
+	/* The permissions are set along with the other attributes below */
+	dest_fd = open (dest_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+	if (dest_fd < 0) {
+		set_not_supported (error);
+		goto out;
+	}
+
+	copied = 0;
+
+#ifdef FICLONE
+	if (ioctl (dest_fd, FICLONE, src_fd) == 0) {
+		copied = src_stat.st_size;
+		if (progress_callback != NULL) {
+			progress_callback (copied, src_stat.st_size, progress_callback_data);
+		}
+		success = TRUE;
+	}
+#endif
+
+	method = COPY_METHOD_COPY_FILE_RANGE;
+	while (!success) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+			break;
+		}
+
+		res = copy_chunk (src_fd, dest_fd, &method, &buffer);
+		if (res < 0 && errno == EINTR) {
+			continue;
+		} else if (res < 0) {
+			set_error_from_errno (error, errno);
+			break;
+		} else if (res == 0 && method != COPY_METHOD_READ_WRITE &&
+			   copied < src_stat.st_size) {
+			/* Some file systems make the kernel copy report the
+			 * end of the file early, read it ourselves instead.
+			 */
+			method = COPY_METHOD_READ_WRITE;
+			continue;
+		} else if (res == 0) {
+			success = TRUE;
+			break;
+		}
+
+		copied += res;
+		if (progress_callback != NULL) {
+			progress_callback (copied, MAX (copied, src_stat.st_size),
+					   progress_callback_data);
+		}
+	}
+
+	if (close (dest_fd) != 0 && success) {
+		errsv = errno;
+		set_error_from_errno (error, errsv);
+		success = FALSE;
+	}
+	dest_fd = -1;
+
+	if (success) {
+		/* Ignore errors here, like g_file_copy() does */
+		g_file_copy_attributes (source, destination, flags, cancellable, NULL);
+	} else {
+		/* Don't leave a partial copy behind */
+		unlink (dest_path);
+	}
+
+ out:
+	if (src_fd >= 0) {
+		close (src_fd);
+	}
+	free (buffer);
+	g_free (src_path);
+	g_free (dest_path);
+
+	return success;
+}
+
+/* rename() that never replaces an existing file. The check for an
+ * existing destination is done by the file system, so it also catches
+ * names differing only in case on case-insensitive file systems.
+ * Returns FALSE, leaving the source in place, if the destination exists
+ * or the rename failed for any other reason.
+ */
+gboolean
+nautilus_local_rename_noreplace (const char *source_path,
+				 const char *destination_path)
+{
+	GStatBuf statbuf;
+
+#ifdef HAVE_RENAMEAT2
+	if (renameat2 (AT_FDCWD, source_path,
+		       AT_FDCWD, destination_path,
+		       RENAME_NOREPLACE) == 0) {
+		return TRUE;
+	}
+
+	/* Only fall back when the file system can't do it atomically */
+	if (errno != EINVAL && errno != ENOSYS) {
+		return FALSE;
+	}
+#endif
+
+	/* Leaves a small window for a file showing up in between, like
+	 * g_file_move() does.
+	 */
+	if (g_lstat (destination_path, &statbuf) == 0 ||
+	    errno != ENOENT) {
+		return FALSE;
+	}
+
+	return g_rename (source_path, destination_path) == 0;
+}
@@ -0,0 +1,37 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-local-copy.h: fast copies between local files
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+  
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+  
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_LOCAL_COPY_H
+#define NAUTILUS_LOCAL_COPY_H
+
+#include <gio/gio.h>
+
+gboolean nautilus_local_copy_file (GFile                 *source,
+				   GFile                 *destination,
+				   GFileCopyFlags         flags,
+				   GCancellable          *cancellable,
+				   GFileProgressCallback  progress_callback,
+				   gpointer               progress_callback_data,
+				   GError               **error);
+
+gboolean nautilus_local_rename_noreplace (const char *source_path,
+					  const char *destination_path);
+
+#endif /* NAUTILUS_LOCAL_COPY_H */
@@ -27,6 +27,21 @@
 
 #include <eel/eel-debug.h>
 #include <gmodule.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_MODULES
+#include "nautilus-debug.h"
+#include "nautilus-profile.h"
+#include "nautilus-signaller.h"
+
+#include <libnautilus-extension/nautilus-menu-provider.h>
+
+/* Remembers which interfaces the types of each extension implement, so
+ * that an extension is only opened once one of those is asked for.
+ */
+#define MANIFEST_FILENAME "extensions-manifest"
+#define MANIFEST_GROUP "Manifest"
 
 #define NAUTILUS_TYPE_MODULE    	(nautilus_module_get_type ())
 #define NAUTILUS_MODULE(obj)		(G_TYPE_CHECK_INSTANCE_CAST ((obj), NAUTILUS_TYPE_MODULE, NautilusModule))
@@ -43,6 +58,15 @@ struct _NautilusModule {
 	GModule *library;
 
 	char *path;
+	gint64 mtime;
+	gint64 size;
+	/* Modification times of the module's script directories, if any */
+	char *extensions_stamp;
+
+	/* Names of the interfaces implemented by the module's types */
+	char **interfaces;
+	gboolean loaded;
+	gint64 load_time;
 
 	void (*initialize) (GTypeModule  *module);
 	void (*shutdown)   (void);
@@ -57,8 +81,10 @@ struct _NautilusModuleClass {
 };
 
 static GList *module_objects = NULL;
+static GList *modules = NULL;
 
 static GType nautilus_module_get_type (void);
+static void save_manifest (void);
 
 G_DEFINE_TYPE (NautilusModule, nautilus_module, G_TYPE_TYPE_MODULE);
 
@@ -142,6 +168,8 @@ nautilus_module_finalize (GObject *object)
 	module = NAUTILUS_MODULE (object);
 
 	g_free (module->path);
+	g_free (module->extensions_stamp);
+	g_strfreev (module->interfaces);
 	
 	G_OBJECT_CLASS (nautilus_module_parent_class)->finalize (object);
 }
@@ -169,42 +197,298 @@ static void
 add_module_objects (NautilusModule *module)
 {
 	const GType *types;
+	GType *type_interfaces;
+	GPtrArray *interfaces;
+	const char *name;
+	guint n_interfaces, j, k;
 	int num_types;
 	int i;
-	
+
 	module->list_types (&types, &num_types);
-	
+
+	interfaces = g_ptr_array_new ();
+
 	for (i = 0; i < num_types; i++) {
 		if (types[i] == 0) { /* Work around broken extensions */
 			break;
 		}
 		nautilus_module_add_type (types[i]);
+
+		type_interfaces = g_type_interfaces (types[i], &n_interfaces);
+		for (j = 0; j < n_interfaces; j++) {
+			name = g_type_name (type_interfaces[j]);
+			for (k = 0; k < interfaces->len; k++) {
+				if (strcmp (g_ptr_array_index (interfaces, k), name) == 0) {
+					break;
+				}
+			}
+			if (k == interfaces->len) {
+				g_ptr_array_add (interfaces, g_strdup (name));
+			}
+		}
+		g_free (type_interfaces);
+	}
+
+	g_ptr_array_add (interfaces, NULL);
+
+	g_strfreev (module->interfaces);
+	module->interfaces = (char **) g_ptr_array_free (interfaces, FALSE);
+}
+
+static gboolean
+interfaces_equal (char **a,
+		  char **b)
+{
+	int i, j;
+
+	if (g_strv_length (a) != g_strv_length (b)) {
+		return FALSE;
+	}
+
+	for (i = 0; a[i] != NULL; i++) {
+		for (j = 0; b[j] != NULL; j++) {
+			if (strcmp (a[i], b[j]) == 0) {
+				break;
+			}
+		}
+		if (b[j] == NULL) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Loader extensions such as nautilus-python register the types of the
+ * scripts found in <datadir>/<name>/extensions, named after the module
+ * lib<name>.so, so their interfaces can change while the module itself
+ * does not. Returns a string that changes when one of those directories
+ * is created, removed or has entries added or removed.
+ */
+static char *
+get_extensions_stamp (const char *path)
+{
+	const char * const *system_dirs;
+	GString *stamp;
+	GStatBuf statbuf;
+	char *basename, *name, *dirname;
+	int i;
+
+	basename = g_path_get_basename (path);
+	name = basename;
+	if (g_str_has_prefix (name, "lib")) {
+		name += strlen ("lib");
+	}
+	if (g_str_has_suffix (name, "." G_MODULE_SUFFIX)) {
+		name[strlen (name) - strlen ("." G_MODULE_SUFFIX)] = '\0';
+	}
+
+	stamp = g_string_new (NULL);
+	system_dirs = g_get_system_data_dirs ();
+
+	for (i = -1; i < 0 || system_dirs[i] != NULL; i++) {
+		dirname = g_build_filename (i < 0 ? g_get_user_data_dir () : system_dirs[i],
+					    name, "extensions", NULL);
+		if (g_stat (dirname, &statbuf) == 0) {
+			g_string_append_printf (stamp, "%s:%" G_GINT64_FORMAT ";",
+						dirname, (gint64) statbuf.st_mtime);
+		}
+		g_free (dirname);
+	}
+
+	g_free (basename);
+
+	return g_string_free (stamp, FALSE);
+}
+
+static gboolean
+nautilus_module_load_types (NautilusModule *module)
+{
+	char **old_interfaces;
+	gint64 start;
+	gboolean ret;
+
+	module->loaded = TRUE;
+	old_interfaces = g_strdupv (module->interfaces);
+
+	nautilus_profile_start ("%s", module->path);
+	start = g_get_monotonic_time ();
+
+	ret = g_type_module_use (G_TYPE_MODULE (module));
+	if (ret) {
+		add_module_objects (module);
+		g_type_module_unuse (G_TYPE_MODULE (module));
+	}
+
+	module->load_time = g_get_monotonic_time () - start;
+	nautilus_profile_end ("%s", module->path);
+
+	DEBUG ("Loaded %s in %" G_GINT64_FORMAT " usec", module->path, module->load_time);
+
+	/* A lazily loaded module that no longer matches its manifest entry */
+	if (ret && old_interfaces != NULL &&
+	    !interfaces_equal (old_interfaces, module->interfaces)) {
+		DEBUG ("Interfaces of %s changed, updating the manifest", module->path);
+		save_manifest ();
+	}
+	g_strfreev (old_interfaces);
+
+	return ret;
+}
+
+static gboolean
+nautilus_module_provides (NautilusModule *module,
+			  const char     *interface_name)
+{
+	int i;
+
+	for (i = 0; module->interfaces[i] != NULL; i++) {
+		if (strcmp (module->interfaces[i], interface_name) == 0) {
+			return TRUE;
+		}
 	}
+
+	return FALSE;
+}
+
+static char *
+get_manifest_path (void)
+{
+	return g_build_filename (g_get_user_cache_dir (), "nautilus", MANIFEST_FILENAME, NULL);
 }
 
-static NautilusModule *
-nautilus_module_load_file (const char *filename)
+static GKeyFile *
+load_manifest (void)
 {
+	GKeyFile *manifest;
+	char *filename;
+	char *version;
+
+	manifest = g_key_file_new ();
+	filename = get_manifest_path ();
+
+	if (g_key_file_load_from_file (manifest, filename, G_KEY_FILE_NONE, NULL)) {
+		/* The interface names are those of this nautilus */
+		version = g_key_file_get_string (manifest, MANIFEST_GROUP, "Version", NULL);
+		if (g_strcmp0 (version, PACKAGE_VERSION) != 0) {
+			g_key_file_free (manifest);
+			manifest = g_key_file_new ();
+		}
+		g_free (version);
+	}
+
+	g_free (filename);
+
+	return manifest;
+}
+
+static void
+save_manifest (void)
+{
+	GKeyFile *manifest;
 	NautilusModule *module;
-	
+	GList *l;
+	char *filename, *dirname, *contents;
+	gsize length;
+	GError *error = NULL;
+
+	manifest = g_key_file_new ();
+	g_key_file_set_string (manifest, MANIFEST_GROUP, "Version", PACKAGE_VERSION);
+
+	for (l = modules; l != NULL; l = l->next) {
+		module = l->data;
+		g_key_file_set_int64 (manifest, module->path, "MTime", module->mtime);
+		g_key_file_set_int64 (manifest, module->path, "Size", module->size);
+		g_key_file_set_string (manifest, module->path, "ExtensionsStamp",
+				       module->extensions_stamp);
+		g_key_file_set_string_list (manifest, module->path, "Interfaces",
+					    (const char * const *) module->interfaces,
+					    g_strv_length (module->interfaces));
+	}
+
+	filename = get_manifest_path ();
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0700);
+
+	contents = g_key_file_to_data (manifest, &length, NULL);
+	if (!g_file_set_contents (filename, contents, length, &error)) {
+		g_warning ("Couldn't save the extensions manifest: %s", error->message);
+		g_error_free (error);
+	}
+
+	g_free (contents);
+	g_free (dirname);
+	g_free (filename);
+	g_key_file_free (manifest);
+}
+
+/* Returns TRUE when the manifest entry of the module was out of date
+ * and has to be rewritten.
+ */
+static gboolean
+load_module_file (const char *filename,
+		  GKeyFile   *manifest)
+{
+	NautilusModule *module;
+	GStatBuf statbuf;
+	char *stamp;
+	gboolean up_to_date, from_manifest;
+
+	if (g_stat (filename, &statbuf) != 0) {
+		return FALSE;
+	}
+
 	module = g_object_new (NAUTILUS_TYPE_MODULE, NULL);
 	module->path = g_strdup (filename);
-	
-	if (g_type_module_use (G_TYPE_MODULE (module))) {
-		add_module_objects (module);
-		g_type_module_unuse (G_TYPE_MODULE (module));
-		return module;
-	} else {
+	module->mtime = statbuf.st_mtime;
+	module->size = statbuf.st_size;
+	module->extensions_stamp = get_extensions_stamp (filename);
+
+	stamp = g_key_file_get_string (manifest, filename, "ExtensionsStamp", NULL);
+	up_to_date =
+		g_key_file_get_int64 (manifest, filename, "MTime", NULL) == module->mtime &&
+		g_key_file_get_int64 (manifest, filename, "Size", NULL) == module->size &&
+		g_strcmp0 (stamp, module->extensions_stamp) == 0 &&
+		g_key_file_has_key (manifest, filename, "Interfaces", NULL);
+	g_free (stamp);
+
+	from_manifest = FALSE;
+	if (up_to_date) {
+		module->interfaces = g_key_file_get_string_list (manifest, filename,
+								 "Interfaces", NULL, NULL);
+
+		/* Modules that registered no types are opened every time,
+		 * as they may only find their types once initialized.
+		 */
+		from_manifest = module->interfaces != NULL && module->interfaces[0] != NULL;
+		if (!from_manifest) {
+			g_strfreev (module->interfaces);
+			module->interfaces = NULL;
+		}
+	}
+
+	if (!from_manifest && !nautilus_module_load_types (module)) {
 		g_object_unref (module);
-		return NULL;
+		return FALSE;
 	}
+
+	modules = g_list_prepend (modules, module);
+
+	return !up_to_date ||
+		(!from_manifest && module->interfaces[0] != NULL);
 }
 
 static void
 load_module_dir (const char *dirname)
 {
 	GDir *dir;
-	
+	GKeyFile *manifest;
+	gboolean manifest_changed;
+	gsize n_groups;
+
+	manifest = load_manifest ();
+	manifest_changed = FALSE;
+
 	dir = g_dir_open (dirname, 0, NULL);
 	
 	if (dir) {
@@ -217,13 +501,24 @@ load_module_dir (const char *dirname)
 				filename = g_build_filename (dirname, 
 							     name, 
 							     NULL);
-				nautilus_module_load_file (filename);
+				if (load_module_file (filename, manifest)) {
+					manifest_changed = TRUE;
+				}
 				g_free (filename);
 			}
 		}
 
 		g_dir_close (dir);
 	}
+
+	/* Also rewrite it when extensions were removed */
+	g_strfreev (g_key_file_get_groups (manifest, &n_groups));
+	if (manifest_changed ||
+	    n_groups != g_list_length (modules) + 1) {
+		save_manifest ();
+	}
+
+	g_key_file_free (manifest);
 }
 
 static void
@@ -256,8 +551,19 @@ nautilus_module_setup (void)
 GList *
 nautilus_module_get_extensions_for_type (GType type)
 {
+	NautilusModule *module;
+	const char *name;
 	GList *l;
 	GList *ret = NULL;
+
+	name = g_type_name (type);
+	for (l = modules; l != NULL; l = l->next) {
+		module = l->data;
+		if (!module->loaded &&
+		    nautilus_module_provides (module, name)) {
+			nautilus_module_load_types (module);
+		}
+	}
 	
 	for (l = module_objects; l != NULL; l = l->next) {
 		if (G_TYPE_CHECK_INSTANCE_TYPE (G_OBJECT (l->data),
@@ -282,6 +588,15 @@ nautilus_module_extension_list_free (GList *extensions)
 	g_list_free (extensions);
 }
 
+static void
+menu_provider_items_updated_handler (NautilusMenuProvider *provider,
+				     GtkWidget            *parent_window,
+				     gpointer              data)
+{
+	g_signal_emit_by_name (nautilus_signaller_get_current (),
+			       "popup-menu-changed");
+}
+
 void   
 nautilus_module_add_type (GType type)
 {
@@ -292,5 +607,14 @@ nautilus_module_add_type (GType type)
 			   (GWeakNotify)module_object_weak_notify,
 			   NULL);
 
+	/* Connected here since menu providers are created whenever their
+	 * module gets loaded, not all at startup.
+	 */
+	if (NAUTILUS_IS_MENU_PROVIDER (object)) {
+		g_signal_connect_after (object, "items-updated",
+					G_CALLBACK (menu_provider_items_updated_handler),
+					NULL);
+	}
+
 	module_objects = g_list_prepend (module_objects, object);
 }
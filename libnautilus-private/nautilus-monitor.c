@@ -28,16 +28,52 @@
 #include "nautilus-monitor.h"
 #include "nautilus-file-changes-queue.h"
 #include "nautilus-file-utilities.h"
+#include "nautilus-directory.h"
 
 #include <gio/gio.h>
 
+#define DEBUG_FLAG NAUTILUS_DEBUG_FILE
+#include "nautilus-debug.h"
+
+/* Events for the same path are merged for this long before they are
+ * handed on to the file changes queue.
+ */
+#define COALESCE_WINDOW_MSEC 50
+
+/* A directory that sees more events than this in a second, or that
+ * has this many distinct paths pending, stops reporting individual
+ * changes and is reloaded at most once a second instead.
+ */
+#define RESCAN_THRESHOLD 1000
+#define RESCAN_INTERVAL_MSEC 1000
+
+typedef enum {
+	MONITOR_EVENT_NONE,
+	MONITOR_EVENT_ADDED,
+	MONITOR_EVENT_CHANGED,
+	MONITOR_EVENT_REMOVED
+} MonitorEventKind;
+
 struct NautilusMonitor {
 	GFileMonitor *monitor;
 	GVolumeMonitor *volume_monitor;
 	GMount *mount;
 	GFile *location;
+
+	/* GFile -> MonitorEventKind */
+	GHashTable *pending;
+	guint flush_id;
+
+	gint64 rate_window_start;
+	guint rate_window_events;
+	gboolean rescan;
 };
 
+static guint64 events_received;
+static guint64 events_merged;
+static guint64 events_dropped;
+static guint64 rescans;
+
 gboolean
 nautilus_monitor_active (void)
 {
@@ -94,6 +130,211 @@ mount_removed (GVolumeMonitor *volume_monitor,
 	}
 }
 
+/* Returns the kind that remains after @next happened to a path that
+ * already had @pending queued.
+ */
+static MonitorEventKind
+merge_events (MonitorEventKind pending,
+	      MonitorEventKind next)
+{
+	switch (pending) {
+	case MONITOR_EVENT_ADDED:
+		if (next == MONITOR_EVENT_REMOVED) {
+			/* Came and went before anyone looked */
+			return MONITOR_EVENT_NONE;
+		}
+		return MONITOR_EVENT_ADDED;
+	case MONITOR_EVENT_REMOVED:
+		if (next == MONITOR_EVENT_ADDED) {
+			/* Replaced by a new file */
+			return MONITOR_EVENT_CHANGED;
+		}
+		return MONITOR_EVENT_REMOVED;
+	case MONITOR_EVENT_CHANGED:
+		return next;
+	case MONITOR_EVENT_NONE:
+	default:
+		return next;
+	}
+}
+
+static void
+flush_pending_events (NautilusMonitor *monitor)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GList *added, *changed, *removed, *l;
+
+	added = NULL;
+	changed = NULL;
+	removed = NULL;
+
+	g_hash_table_iter_init (&iter, monitor->pending);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		switch (GPOINTER_TO_INT (value)) {
+		case MONITOR_EVENT_ADDED:
+			added = g_list_prepend (added, key);
+			break;
+		case MONITOR_EVENT_CHANGED:
+			changed = g_list_prepend (changed, key);
+			break;
+		case MONITOR_EVENT_REMOVED:
+			removed = g_list_prepend (removed, key);
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* Queue each kind together, the queue flushes whenever the kind
+	 * flips.
+	 */
+	for (l = removed; l != NULL; l = l->next) {
+		nautilus_file_changes_queue_file_removed (l->data);
+	}
+	for (l = added; l != NULL; l = l->next) {
+		nautilus_file_changes_queue_file_added (l->data);
+	}
+	for (l = changed; l != NULL; l = l->next) {
+		nautilus_file_changes_queue_file_changed (l->data);
+	}
+
+	g_list_free (added);
+	g_list_free (changed);
+	g_list_free (removed);
+
+	g_hash_table_remove_all (monitor->pending);
+
+	schedule_call_consume_changes ();
+}
+
+/* Counts over all monitors: events received, events folded into one
+ * already pending for the same path, and events dropped because their
+ * directory was being rescanned instead.
+ */
+static void
+log_statistics (NautilusMonitor *monitor,
+		const char *what)
+{
+	char *uri;
+
+	uri = g_file_get_uri (monitor->location);
+	DEBUG ("%s rescan mode for %s: %" G_GUINT64_FORMAT " events received, "
+	       "%" G_GUINT64_FORMAT " merged, %" G_GUINT64_FORMAT " dropped, "
+	       "%" G_GUINT64_FORMAT " rescans",
+	       what, uri, events_received, events_merged, events_dropped, rescans);
+	g_free (uri);
+}
+
+static void
+rescan_directory (NautilusMonitor *monitor)
+{
+	NautilusDirectory *directory;
+
+	directory = nautilus_directory_get_existing (monitor->location);
+	if (directory != NULL) {
+		nautilus_directory_force_reload (directory);
+		nautilus_directory_unref (directory);
+	}
+
+	rescans++;
+}
+
+static gboolean
+flush_timeout_cb (gpointer user_data)
+{
+	NautilusMonitor *monitor = user_data;
+
+	if (!monitor->rescan) {
+		monitor->flush_id = 0;
+		flush_pending_events (monitor);
+		return FALSE;
+	}
+
+	rescan_directory (monitor);
+
+	/* Keep reloading once an interval for as long as the
+	 * directory stays busy.
+	 */
+	if (g_get_monotonic_time () - monitor->rate_window_start < G_USEC_PER_SEC &&
+	    monitor->rate_window_events > RESCAN_THRESHOLD) {
+		return TRUE;
+	}
+
+	monitor->rescan = FALSE;
+	monitor->flush_id = 0;
+	log_statistics (monitor, "Leaving");
+	return FALSE;
+}
+
+static void
+enter_rescan_mode (NautilusMonitor *monitor)
+{
+	events_dropped += g_hash_table_size (monitor->pending);
+	g_hash_table_remove_all (monitor->pending);
+	monitor->rescan = TRUE;
+	log_statistics (monitor, "Entering");
+
+	if (monitor->flush_id != 0) {
+		g_source_remove (monitor->flush_id);
+	}
+	monitor->flush_id = g_timeout_add (RESCAN_INTERVAL_MSEC,
+					   flush_timeout_cb, monitor);
+}
+
+static void
+queue_event (NautilusMonitor *monitor,
+	     GFile *location,
+	     MonitorEventKind kind)
+{
+	gpointer key, value;
+	MonitorEventKind merged;
+	gint64 now;
+
+	events_received++;
+
+	now = g_get_monotonic_time ();
+	if (now - monitor->rate_window_start >= G_USEC_PER_SEC) {
+		monitor->rate_window_start = now;
+		monitor->rate_window_events = 0;
+	}
+	monitor->rate_window_events++;
+
+	if (monitor->rescan) {
+		events_dropped++;
+		return;
+	}
+
+	if (monitor->rate_window_events > RESCAN_THRESHOLD ||
+	    g_hash_table_size (monitor->pending) >= RESCAN_THRESHOLD) {
+		events_dropped++;
+		enter_rescan_mode (monitor);
+		return;
+	}
+
+	if (g_hash_table_lookup_extended (monitor->pending, location, &key, &value)) {
+		events_merged++;
+		merged = merge_events (GPOINTER_TO_INT (value), kind);
+		if (merged == MONITOR_EVENT_NONE) {
+			/* Both events cancel out */
+			g_hash_table_remove (monitor->pending, key);
+		} else {
+			g_hash_table_insert (monitor->pending,
+					     g_object_ref (location),
+					     GINT_TO_POINTER (merged));
+		}
+	} else {
+		g_hash_table_insert (monitor->pending,
+				     g_object_ref (location),
+				     GINT_TO_POINTER (kind));
+	}
+
+	if (monitor->flush_id == 0) {
+		monitor->flush_id = g_timeout_add (COALESCE_WINDOW_MSEC,
+						   flush_timeout_cb, monitor);
+	}
+}
+
 static void
 dir_changed (GFileMonitor* monitor,
 	     GFile *child,
@@ -101,14 +342,6 @@ dir_changed (GFileMonitor* monitor,
 	     GFileMonitorEvent event_type,
 	     gpointer user_data)
 {
-	char *uri, *to_uri;
-	
-	uri = g_file_get_uri (child);
-	to_uri = NULL;
-	if (other_file) {
-		to_uri = g_file_get_uri (other_file);
-	}
-
 	switch (event_type) {
 	default:
 	case G_FILE_MONITOR_EVENT_CHANGED:
@@ -116,23 +349,18 @@ dir_changed (GFileMonitor* monitor,
 		break;
 	case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
 	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
-		nautilus_file_changes_queue_file_changed (child);
+		queue_event (user_data, child, MONITOR_EVENT_CHANGED);
 		break;
 	case G_FILE_MONITOR_EVENT_UNMOUNTED:
 	case G_FILE_MONITOR_EVENT_DELETED:
-		nautilus_file_changes_queue_file_removed (child);
+		queue_event (user_data, child, MONITOR_EVENT_REMOVED);
 		break;
 	case G_FILE_MONITOR_EVENT_CREATED:
-		nautilus_file_changes_queue_file_added (child);
+		queue_event (user_data, child, MONITOR_EVENT_ADDED);
 		break;
 	}
-
-	g_free (uri);
-	g_free (to_uri);
-
-	schedule_call_consume_changes ();
 }
- 
+
 NautilusMonitor *
 nautilus_monitor_directory (GFile *location)
 {
@@ -140,13 +368,15 @@ nautilus_monitor_directory (GFile *location)
 	NautilusMonitor *ret;
 
 	ret = g_slice_new0 (NautilusMonitor);
+	ret->location = g_object_ref (location);
+	ret->pending = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+					      g_object_unref, NULL);
 	dir_monitor = g_file_monitor_directory (location, G_FILE_MONITOR_WATCH_MOUNTS, NULL, NULL);
 
 	if (dir_monitor != NULL) {
 		ret->monitor = dir_monitor;
 	} else if (!g_file_is_native (location)) {
 		ret->mount = nautilus_get_mounted_mount_for_root (location);
-		ret->location = g_object_ref (location);
 		ret->volume_monitor = g_volume_monitor_get ();
 	}
 
@@ -178,6 +408,17 @@ nautilus_monitor_cancel (NautilusMonitor *monitor)
 		g_object_unref (monitor->volume_monitor);
 	}
 
+	if (monitor->flush_id != 0) {
+		g_source_remove (monitor->flush_id);
+	}
+
+	/* Don't lose the changes still waiting out the coalesce window */
+	if (g_hash_table_size (monitor->pending) > 0) {
+		flush_pending_events (monitor);
+		nautilus_file_changes_consume_changes (TRUE);
+	}
+	g_hash_table_destroy (monitor->pending);
+
 	g_clear_object (&monitor->location);
 	g_clear_object (&monitor->mount);
 	g_slice_free (NautilusMonitor, monitor);
@@ -0,0 +1,121 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-mpsc-queue.c: lock-free multi-producer single-consumer queue
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+  
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+  
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <config.h>
+#include "nautilus-mpsc-queue.h"
+
+/* Producers push onto a shared stack with a compare-and-swap. The
+ * consumer detaches the whole stack at once and reverses it into a
+ * private batch that it pops from without touching shared state
+ * again until the batch runs out.
+ *
+ * Producers never remove nodes, so a node being reused at the same
+ * address between a producer's read of the top and its swap is
+ * harmless: the new node still points at the current top.
+ */
+struct NautilusMpscQueue {
+	GSList *pushed;  /* shared, newest first */
+	GSList *batch;   /* consumer only, oldest first */
+};
+
+NautilusMpscQueue *
+nautilus_mpsc_queue_new (void)
+{
+	return g_slice_new0 (NautilusMpscQueue);
+}
+
+void
+nautilus_mpsc_queue_free (NautilusMpscQueue *queue,
+			  GDestroyNotify free_func)
+{
+	gpointer data;
+
+	while ((data = nautilus_mpsc_queue_pop (queue)) != NULL) {
+		if (free_func != NULL) {
+			free_func (data);
+		}
+	}
+
+	g_slice_free (NautilusMpscQueue, queue);
+}
+
+/* May be called from any thread. @data must not be %NULL. */
+void
+nautilus_mpsc_queue_push (NautilusMpscQueue *queue,
+			  gpointer data)
+{
+	GSList *node;
+	GSList *top;
+
+	g_return_if_fail (data != NULL);
+
+	node = g_slist_alloc ();
+	node->data = data;
+
+	do {
+		top = g_atomic_pointer_get (&queue->pushed);
+		node->next = top;
+	} while (!g_atomic_pointer_compare_and_exchange (&queue->pushed, top, node));
+}
+
+static gboolean
+take_batch (NautilusMpscQueue *queue)
+{
+	GSList *pushed;
+
+	do {
+		pushed = g_atomic_pointer_get (&queue->pushed);
+		if (pushed == NULL) {
+			return FALSE;
+		}
+	} while (!g_atomic_pointer_compare_and_exchange (&queue->pushed, pushed, NULL));
+
+	queue->batch = g_slist_reverse (pushed);
+	return TRUE;
+}
+
+/* Must only be called from the consuming thread. Returns %NULL
+ * when the queue is empty.
+ */
+gpointer
+nautilus_mpsc_queue_pop (NautilusMpscQueue *queue)
+{
+	GSList *node;
+	gpointer data;
+
+	if (queue->batch == NULL && !take_batch (queue)) {
+		return NULL;
+	}
+
+	node = queue->batch;
+	queue->batch = node->next;
+	data = node->data;
+	g_slist_free_1 (node);
+
+	return data;
+}
+
+/* Must only be called from the consuming thread */
+gboolean
+nautilus_mpsc_queue_is_empty (NautilusMpscQueue *queue)
+{
+	return queue->batch == NULL &&
+		g_atomic_pointer_get (&queue->pushed) == NULL;
+}
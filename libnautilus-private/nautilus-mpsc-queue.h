@@ -0,0 +1,39 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   nautilus-mpsc-queue.h: lock-free multi-producer single-consumer queue
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+  
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+  
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#ifndef NAUTILUS_MPSC_QUEUE_H
+#define NAUTILUS_MPSC_QUEUE_H
+
+#include <glib.h>
+
+/* Any number of threads may push, a single thread pops. Items pushed
+ * by the same thread are popped in the order they were pushed.
+ */
+typedef struct NautilusMpscQueue NautilusMpscQueue;
+
+NautilusMpscQueue *nautilus_mpsc_queue_new      (void);
+void               nautilus_mpsc_queue_free     (NautilusMpscQueue *queue,
+						 GDestroyNotify     free_func);
+void               nautilus_mpsc_queue_push     (NautilusMpscQueue *queue,
+						 gpointer           data);
+gpointer           nautilus_mpsc_queue_pop      (NautilusMpscQueue *queue);
+gboolean           nautilus_mpsc_queue_is_empty (NautilusMpscQueue *queue);
+
+#endif /* NAUTILUS_MPSC_QUEUE_H */
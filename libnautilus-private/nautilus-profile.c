@@ -34,6 +34,42 @@
 
 #include "nautilus-profile.h"
 
+G_LOCK_DEFINE_STATIC (timeline);
+
+static void
+timeline_log (const char *func,
+              const char *note,
+              const char *message)
+{
+        static FILE    *timeline = NULL;
+        static gboolean timeline_checked = FALSE;
+        const char     *path;
+
+        G_LOCK (timeline);
+
+        if (!timeline_checked) {
+                timeline_checked = TRUE;
+                path = g_getenv ("NAUTILUS_PROFILE_TIMELINE");
+                if (path != NULL && path[0] != '\0') {
+                        timeline = g_fopen (path, "a");
+                }
+        }
+
+        if (timeline != NULL) {
+                /* Flushed per line so a watching process sees the
+                 * marks as they happen.
+                 */
+                fprintf (timeline, "%" G_GINT64_FORMAT "\t%s\t%s\t%s\n",
+                         g_get_monotonic_time (),
+                         func ? func : "",
+                         note ? note : "",
+                         message);
+                fflush (timeline);
+        }
+
+        G_UNLOCK (timeline);
+}
+
 void
 _nautilus_profile_log (const char *func,
                        const char *note,
@@ -58,6 +94,7 @@ _nautilus_profile_log (const char *func,
                 str = g_strdup_printf ("MARK: %s: %s %s", g_get_prgname(), note ? note : "", formatted);
         }
 
+        timeline_log (func, note, formatted);
         g_free (formatted);
 
         g_access (str, F_OK);
@@ -23,6 +23,11 @@
  *       python plot-timeline.py -o prettygraph.png /tmp/logfile.strace
  *
  *       See: http://www.gnome.org/~federico/news-2006-03.html#09
+ *
+ * Setting NAUTILUS_PROFILE_TIMELINE=<file> additionally appends every
+ * mark to <file> as a tab separated line:
+ *       <monotonic time in usec> <function> <start|end|> <message>
+ * which is what test/test-nautilus-startup-time reads.
  */
 
 #ifndef __NAUTILUS_PROFILE_H
@@ -114,9 +114,17 @@ static void
 vfs_force_reload (NautilusDirectory *directory)
 {
 	NautilusFileAttributes all_attributes;
+	GList *l;
 
 	g_assert (NAUTILUS_IS_DIRECTORY (directory));
 
+	/* Extensions like VCS ones change their info without the files
+	 * changing, and reloading is how the user asks for it again.
+	 */
+	for (l = directory->details->file_list; l != NULL; l = l->next) {
+		nautilus_file_forget_extension_info (l->data);
+	}
+
 	all_attributes = nautilus_file_get_all_attributes ();
 	nautilus_directory_force_reload_internal (directory,
 						  all_attributes);
@@ -82,6 +82,52 @@ vfs_file_check_if_ready (NautilusFile *file,
 		 file_attributes);
 }
 
+/* Metadata writes are collected per directory for a short while so
+ * that a burst of changes (e.g. saving the icon layout of a folder)
+ * costs one write per file instead of one per key.
+ */
+#define METADATA_WRITE_DELAY_MSEC 100
+
+typedef struct {
+	NautilusDirectory *directory;
+	GHashTable *files; /* NautilusFile -> GFileInfo */
+	guint timeout_id;
+} MetadataBatch;
+
+typedef struct {
+	NautilusFile *file;
+	GFileInfo *info;
+} MetadataWrite;
+
+static GHashTable *metadata_batches; /* NautilusDirectory -> MetadataBatch */
+static GHashTable *metadata_writes_in_flight; /* NautilusFile -> count */
+
+static gboolean
+metadata_write_is_last (NautilusFile *file)
+{
+	guint count;
+	MetadataBatch *batch;
+
+	count = GPOINTER_TO_UINT (g_hash_table_lookup (metadata_writes_in_flight, file));
+	if (count > 1) {
+		g_hash_table_insert (metadata_writes_in_flight, file,
+				     GUINT_TO_POINTER (count - 1));
+		return FALSE;
+	}
+	g_hash_table_remove (metadata_writes_in_flight, file);
+
+	batch = g_hash_table_lookup (metadata_batches, file->details->directory);
+	return batch == NULL || g_hash_table_lookup (batch->files, file) == NULL;
+}
+
+static void
+metadata_write_free (MetadataWrite *write)
+{
+	nautilus_file_unref (write->file);
+	g_object_unref (write->info);
+	g_slice_free (MetadataWrite, write);
+}
+
 static void
 set_metadata_get_info_callback (GObject *source_object,
 				GAsyncResult *res,
@@ -112,11 +158,11 @@ set_metadata_callback (GObject *source_object,
 		       GAsyncResult *result,
 		       gpointer callback_data)
 {
-	NautilusFile *file;
+	MetadataWrite *write;
 	GError *error;
 	gboolean res;
 
-	file = callback_data;
+	write = callback_data;
 
 	error = NULL;
 	res = g_file_set_attributes_finish (G_FILE (source_object),
@@ -124,17 +170,170 @@ set_metadata_callback (GObject *source_object,
 					    NULL,
 					    &error);
 
-	if (res) {
+	if (!metadata_write_is_last (write->file)) {
+		/* A newer write for this file will sort things out */
+		if (!res) {
+			g_error_free (error);
+		}
+	} else if (res) {
+		/* The values were applied when they were queued, but a
+		 * reload in the meantime may have brought back the old
+		 * ones, so apply them again rather than re-querying.
+		 */
+		if (nautilus_file_merge_metadata_from_info (write->file, write->info)) {
+			nautilus_file_changed (write->file);
+		}
+	} else {
+		/* Our local copy is wrong now, get the real values back */
 		g_file_query_info_async (G_FILE (source_object),
 					 NAUTILUS_FILE_DEFAULT_ATTRIBUTES,
 					 0,
 					 G_PRIORITY_DEFAULT,
 					 NULL,
-					 set_metadata_get_info_callback, file);
-	} else {
-		nautilus_file_unref (file);
+					 set_metadata_get_info_callback,
+					 nautilus_file_ref (write->file));
 		g_error_free (error);
 	}
+
+	metadata_write_free (write);
+}
+
+static void
+metadata_batch_free (MetadataBatch *batch)
+{
+	if (batch->timeout_id != 0) {
+		g_source_remove (batch->timeout_id);
+	}
+	g_hash_table_destroy (batch->files);
+	nautilus_directory_unref (batch->directory);
+	g_slice_free (MetadataBatch, batch);
+}
+
+static gboolean
+metadata_batch_flush (gpointer user_data)
+{
+	MetadataBatch *batch;
+	GHashTableIter iter;
+	gpointer key, value;
+	MetadataWrite *write;
+	GFile *location;
+	guint count;
+
+	batch = user_data;
+	batch->timeout_id = 0;
+
+	if (metadata_writes_in_flight == NULL) {
+		metadata_writes_in_flight = g_hash_table_new (NULL, NULL);
+	}
+
+	g_hash_table_iter_init (&iter, batch->files);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		write = g_slice_new (MetadataWrite);
+		write->file = nautilus_file_ref (key);
+		write->info = g_object_ref (value);
+
+		count = GPOINTER_TO_UINT (g_hash_table_lookup (metadata_writes_in_flight, key));
+		g_hash_table_insert (metadata_writes_in_flight, key,
+				     GUINT_TO_POINTER (count + 1));
+
+		location = nautilus_file_get_location (write->file);
+		g_file_set_attributes_async (location,
+					     write->info,
+					     0,
+					     G_PRIORITY_DEFAULT,
+					     NULL,
+					     set_metadata_callback,
+					     write);
+		g_object_unref (location);
+	}
+
+	g_hash_table_remove (metadata_batches, batch->directory);
+
+	return FALSE;
+}
+
+static void
+metadata_batch_add (NautilusFile *file,
+		    GFileInfo *info)
+{
+	MetadataBatch *batch;
+	GFileInfo *pending;
+	char **attrs;
+	GFileAttributeType type;
+	gpointer value;
+	int i;
+
+	/* Readers see the new values right away */
+	if (nautilus_file_merge_metadata_from_info (file, info)) {
+		nautilus_file_changed (file);
+	}
+
+	if (metadata_batches == NULL) {
+		metadata_batches = g_hash_table_new_full (NULL, NULL, NULL,
+							  (GDestroyNotify) metadata_batch_free);
+	}
+
+	batch = g_hash_table_lookup (metadata_batches, file->details->directory);
+	if (batch == NULL) {
+		batch = g_slice_new0 (MetadataBatch);
+		batch->directory = nautilus_directory_ref (file->details->directory);
+		batch->files = g_hash_table_new_full (NULL, NULL,
+						      (GDestroyNotify) nautilus_file_unref,
+						      g_object_unref);
+		batch->timeout_id = g_timeout_add (METADATA_WRITE_DELAY_MSEC,
+						   metadata_batch_flush, batch);
+		g_hash_table_insert (metadata_batches, batch->directory, batch);
+	}
+
+	pending = g_hash_table_lookup (batch->files, file);
+	if (pending == NULL) {
+		g_hash_table_insert (batch->files, nautilus_file_ref (file),
+				     g_object_ref (info));
+		return;
+	}
+
+	/* Later values for a key replace earlier ones */
+	attrs = g_file_info_list_attributes (info, "metadata");
+	for (i = 0; attrs[i] != NULL; i++) {
+		if (g_file_info_get_attribute_data (info, attrs[i],
+						    &type, &value, NULL)) {
+			g_file_info_set_attribute (pending, attrs[i], type, value);
+		}
+	}
+	g_strfreev (attrs);
+}
+
+/* Writes the metadata still waiting in batches synchronously, for when
+ * there is no main loop left to run the timeouts.
+ */
+void
+nautilus_vfs_file_flush_metadata (void)
+{
+	GHashTableIter batch_iter, iter;
+	gpointer key, value;
+	MetadataBatch *batch;
+	GFile *location;
+	GError *error;
+
+	if (metadata_batches == NULL) {
+		return;
+	}
+
+	g_hash_table_iter_init (&batch_iter, metadata_batches);
+	while (g_hash_table_iter_next (&batch_iter, NULL, (gpointer *) &batch)) {
+		g_hash_table_iter_init (&iter, batch->files);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			location = nautilus_file_get_location (key);
+			error = NULL;
+			if (!g_file_set_attributes_from_info (location, value, 0, NULL, &error)) {
+				g_warning ("Couldn't save metadata: %s", error->message);
+				g_error_free (error);
+			}
+			g_object_unref (location);
+		}
+	}
+
+	g_hash_table_remove_all (metadata_batches);
 }
 
 static void
@@ -143,7 +342,6 @@ vfs_file_set_metadata (NautilusFile           *file,
 		       const char             *value)
 {
 	GFileInfo *info;
-	GFile *location;
 	char *gio_key;
 
 	info = g_file_info_new ();
@@ -159,15 +357,7 @@ vfs_file_set_metadata (NautilusFile           *file,
 	}
 	g_free (gio_key);
 
-	location = nautilus_file_get_location (file);
-	g_file_set_attributes_async (location,
-				     info,
-				     0,
-				     G_PRIORITY_DEFAULT,
-				     NULL,
-				     set_metadata_callback,
-				     nautilus_file_ref (file));
-	g_object_unref (location);
+	metadata_batch_add (file, info);
 	g_object_unref (info);
 }
 
@@ -176,7 +366,6 @@ vfs_file_set_metadata_as_list (NautilusFile           *file,
 			       const char             *key,
 			       char                  **value)
 {
-	GFile *location;
 	GFileInfo *info;
 	char *gio_key;
 
@@ -186,16 +375,8 @@ vfs_file_set_metadata_as_list (NautilusFile           *file,
 	g_file_info_set_attribute_stringv (info, gio_key, value);
 	g_free (gio_key);
 
-	location = nautilus_file_get_location (file);
-	g_file_set_attributes_async (location,
-				     info,
-				     0,
-				     G_PRIORITY_DEFAULT,
-				     NULL,
-				     set_metadata_callback,
-				     nautilus_file_ref (file));
+	metadata_batch_add (file, info);
 	g_object_unref (info);
-	g_object_unref (location);
 }
 
 static gboolean
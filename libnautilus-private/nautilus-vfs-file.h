@@ -52,4 +52,6 @@ typedef struct {
 
 GType   nautilus_vfs_file_get_type (void);
 
+void    nautilus_vfs_file_flush_metadata (void);
+
 #endif /* NAUTILUS_VFS_FILE_H */
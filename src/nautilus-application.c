@@ -62,7 +62,7 @@
 #include <libnautilus-private/nautilus-profile.h>
 #include <libnautilus-private/nautilus-signaller.h>
 #include <libnautilus-private/nautilus-ui-utilities.h>
-#include <libnautilus-extension/nautilus-menu-provider.h>
+#include <libnautilus-private/nautilus-vfs-file.h>
 
 #define DEBUG_FLAG NAUTILUS_DEBUG_APPLICATION
 #include <libnautilus-private/nautilus-debug.h>
@@ -113,6 +113,9 @@ struct _NautilusApplicationPriv {
 	GtkWidget *connect_server_window;
 
 	NautilusShellSearchProvider *search_provider;
+
+	guint startup_task;
+	guint startup_idle_id;
 };
 
 NautilusBookmarkList *
@@ -258,33 +261,6 @@ check_required_directories (NautilusApplication *application)
 	return ret;
 }
 
-static void
-menu_provider_items_updated_handler (NautilusMenuProvider *provider, GtkWidget* parent_window, gpointer data)
-{
-
-	g_signal_emit_by_name (nautilus_signaller_get_current (),
-			       "popup-menu-changed");
-}
-
-static void
-menu_provider_init_callback (void)
-{
-        GList *providers;
-        GList *l;
-
-        providers = nautilus_module_get_extensions_for_type (NAUTILUS_TYPE_MENU_PROVIDER);
-
-        for (l = providers; l != NULL; l = l->next) {
-                NautilusMenuProvider *provider = NAUTILUS_MENU_PROVIDER (l->data);
-
-		g_signal_connect_after (G_OBJECT (provider), "items-updated",
-                           (GCallback)menu_provider_items_updated_handler,
-                           NULL);
-        }
-
-        nautilus_module_extension_list_free (providers);
-}
-
 static void
 mark_desktop_files_trusted (void)
 {
@@ -514,6 +490,21 @@ another_navigation_window_already_showing (NautilusApplication *application,
 	return FALSE;
 }
 
+static gboolean first_window_created = FALSE;
+
+static gboolean
+first_window_draw_callback (GtkWidget *window,
+			    cairo_t   *cr,
+			    gpointer   user_data)
+{
+	/* test-nautilus-startup-time waits for this mark */
+	nautilus_profile_msg ("First window drawn");
+
+	g_signal_handlers_disconnect_by_func (window, first_window_draw_callback, user_data);
+
+	return FALSE;
+}
+
 NautilusWindow *
 nautilus_application_create_window (NautilusApplication *application,
 				    GdkScreen           *screen)
@@ -552,6 +543,12 @@ nautilus_application_create_window (NautilusApplication *application,
 	}
 	g_free (geometry_string);
 
+	if (!first_window_created) {
+		first_window_created = TRUE;
+		g_signal_connect_after (window, "draw",
+					G_CALLBACK (first_window_draw_callback), NULL);
+	}
+
 	DEBUG ("Creating a new navigation window");
 	nautilus_profile_end (NULL);
 
@@ -1075,6 +1072,10 @@ nautilus_application_finalize (GObject *object)
 	g_clear_object (&application->priv->fdb_manager);
 	g_clear_object (&application->priv->search_provider);
 
+	if (application->priv->startup_idle_id != 0) {
+		g_source_remove (application->priv->startup_idle_id);
+	}
+
 	notify_uninit ();
 
         G_OBJECT_CLASS (nautilus_application_parent_class)->finalize (object);
@@ -1578,6 +1579,64 @@ init_gtk_accels (void)
 	g_free (old_scripts_directory_path);
 }
 
+static void
+startup_init_previewer (NautilusApplication *self)
+{
+	nautilus_previewer_get_singleton ();
+}
+
+static void
+startup_init_search_provider (NautilusApplication *self)
+{
+	self->priv->search_provider = nautilus_shell_search_provider_new ();
+}
+
+static void
+startup_check_required_directories (NautilusApplication *self)
+{
+	/* Check the user's .nautilus directories and post warnings
+	 * if there are problems.
+	 */
+	check_required_directories (self);
+}
+
+typedef struct {
+	const char *name;
+	void (* func) (NautilusApplication *self);
+} StartupTask;
+
+/* Things the first window does not need; they are run one per idle
+ * after it had a chance to show up.
+ */
+static const StartupTask deferred_startup_tasks[] = {
+	{ "Previewer", startup_init_previewer },
+	{ "Search provider", startup_init_search_provider },
+	{ "Required directories", startup_check_required_directories },
+	{ "Upgrades", do_upgrades_once },
+};
+
+static gboolean
+run_deferred_startup_task (gpointer user_data)
+{
+	NautilusApplication *self = user_data;
+	const StartupTask *task;
+
+	task = &deferred_startup_tasks[self->priv->startup_task++];
+
+	nautilus_profile_start ("%s", task->name);
+	task->func (self);
+	nautilus_profile_end ("%s", task->name);
+
+	if (self->priv->startup_task < G_N_ELEMENTS (deferred_startup_tasks)) {
+		return TRUE;
+	}
+
+	nautilus_profile_msg ("Deferred startup done");
+	self->priv->startup_idle_id = 0;
+
+	return FALSE;
+}
+
 static void
 nautilus_application_startup (GApplication *app)
 {
@@ -1592,10 +1651,9 @@ nautilus_application_startup (GApplication *app)
 
 	gtk_window_set_default_icon_name ("system-file-manager");
 
-	/* initialize the previewer singleton */
-	nautilus_previewer_get_singleton ();
-
-	/* create DBus manager */
+	/* create DBus manager; FileOperations calls are dispatched as
+	 * soon as the main loop runs, so it can not wait for idle.
+	 */
 	self->priv->dbus_manager = nautilus_dbus_manager_new ();
 	self->priv->fdb_manager = nautilus_freedesktop_dbus_new ();
 
@@ -1624,27 +1682,24 @@ nautilus_application_startup (GApplication *app)
 	nautilus_module_setup ();
 	nautilus_profile_end ("Modules");
 
-	/* attach menu-provider module callback */
-	menu_provider_init_callback ();
-	
-	/* Initialize the UI handler singleton for file operations */
+	/* Initialize the UI handler singleton for file operations. It only
+	 * hears about operations started after it exists, and those can
+	 * come in over D-Bus as soon as the main loop runs.
+	 */
 	notify_init (GETTEXT_PACKAGE);
 	self->priv->progress_handler = nautilus_progress_ui_handler_new ();
 
-	/* Bookmarks and search */
+	/* Bookmarks */
 	self->priv->bookmark_list = nautilus_bookmark_list_new ();
-	self->priv->search_provider = nautilus_shell_search_provider_new ();
-
-	/* Check the user's .nautilus directories and post warnings
-	 * if there are problems.
-	 */
-	check_required_directories (self);
-
-	do_upgrades_once (self);
 
 	nautilus_application_init_actions (self);
 	init_desktop (self);
 
+	self->priv->startup_idle_id =
+		g_idle_add_full (G_PRIORITY_LOW,
+				 run_deferred_startup_task,
+				 self, NULL);
+
 	nautilus_profile_end (NULL);
 }
 
@@ -1655,6 +1710,7 @@ nautilus_application_quit_mainloop (GApplication *app)
 
 	nautilus_icon_info_clear_caches ();
  	nautilus_application_save_accel_map (NULL);
+	nautilus_vfs_file_flush_metadata ();
 
 	nautilus_application_notify_unmount_done (NAUTILUS_APPLICATION (app), NULL);
 
@@ -73,8 +73,10 @@ struct NautilusListModelDetails {
 	int drag_begin_y;
 
 	GPtrArray *columns;
+	GArray *column_attributes; /* attribute_q of each column, to avoid g_object_get per cell */
 
-	GList *highlight_files;
+	/* NautilusFiles are unique per location, so a pointer set is enough */
+	GHashTable *highlight_files;
 };
 
 typedef struct {
@@ -93,6 +95,14 @@ struct FileEntry {
 	GSequence *files;
 	GSequenceIter *ptr;
 	guint loaded : 1;
+
+	/* Rendered cell values, dropped whenever the file changes. Tree views
+	 * ask for every visible cell on every redraw, so recomputing them each
+	 * time is costly.
+	 */
+	GdkPixbuf *icons[NAUTILUS_ZOOM_LEVEL_N_ENTRIES];
+	char **strings;
+	guint n_strings;
 };
 
 G_DEFINE_TYPE_WITH_CODE (NautilusListModel, nautilus_list_model, G_TYPE_OBJECT,
@@ -106,9 +116,27 @@ static const GtkTargetEntry drag_types [] = {
 	{ NAUTILUS_ICON_DND_URI_LIST_TYPE, 0, NAUTILUS_ICON_DND_URI_LIST },
 };
 
+static void
+file_entry_invalidate_cache (FileEntry *file_entry)
+{
+	guint i;
+
+	for (i = 0; i < NAUTILUS_ZOOM_LEVEL_N_ENTRIES; i++) {
+		g_clear_object (&file_entry->icons[i]);
+	}
+
+	for (i = 0; i < file_entry->n_strings; i++) {
+		g_free (file_entry->strings[i]);
+	}
+	g_free (file_entry->strings);
+	file_entry->strings = NULL;
+	file_entry->n_strings = 0;
+}
+
 static void
 file_entry_free (FileEntry *file_entry)
 {
+	file_entry_invalidate_cache (file_entry);
 	nautilus_file_unref (file_entry->file);
 	if (file_entry->reverse_map) {
 		g_hash_table_destroy (file_entry->reverse_map);
@@ -235,18 +263,86 @@ nautilus_list_model_get_path (GtkTreeModel *tree_model, GtkTreeIter *iter)
 	return path;
 }
 
-static void
-nautilus_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column, GValue *value)
+static GdkPixbuf *
+render_file_icon (NautilusListModel *model,
+		  NautilusFile *file,
+		  int icon_size,
+		  NautilusFileIconFlags flags)
 {
-	NautilusListModel *model;
-	FileEntry *file_entry;
-	NautilusFile *file;
-	char *str;
 	GdkPixbuf *icon, *rendered_icon;
 	GIcon *gicon, *emblemed_icon, *emblem_icon;
 	NautilusIconInfo *icon_info;
 	GEmblem *emblem;
 	GList *emblem_icons, *l;
+
+	gicon = G_ICON (nautilus_file_get_icon_pixbuf (file, icon_size, TRUE, flags));
+	emblem_icons = nautilus_file_get_emblem_icons (file);
+
+	/* pick only the first emblem we can render for the list view */
+	for (l = emblem_icons; l != NULL; l = l->next) {
+		emblem_icon = l->data;
+		if (nautilus_icon_theme_can_render (G_THEMED_ICON (emblem_icon))) {
+			emblem = g_emblem_new (emblem_icon);
+			emblemed_icon = g_emblemed_icon_new (gicon, emblem);
+
+			g_object_unref (gicon);
+			g_object_unref (emblem);
+			gicon = emblemed_icon;
+
+			break;
+		}
+	}
+
+	g_list_free_full (emblem_icons, g_object_unref);
+
+	icon_info = nautilus_icon_info_lookup (gicon, icon_size);
+	icon = nautilus_icon_info_get_pixbuf_at_size (icon_info, icon_size);
+
+	g_object_unref (icon_info);
+	g_object_unref (gicon);
+
+	if (model->details->highlight_files != NULL &&
+	    g_hash_table_contains (model->details->highlight_files, file)) {
+		rendered_icon = eel_create_spotlight_pixbuf (icon);
+
+		if (rendered_icon != NULL) {
+			g_object_unref (icon);
+			icon = rendered_icon;
+		}
+	}
+
+	return icon;
+}
+
+/* Returns a string owned by file_entry. */
+static const char *
+file_entry_get_string_attribute (FileEntry *file_entry,
+				 guint index,
+				 GQuark attribute)
+{
+	if (index >= file_entry->n_strings) {
+		file_entry->strings = g_renew (char *, file_entry->strings, index + 1);
+		memset (file_entry->strings + file_entry->n_strings, 0,
+			(index + 1 - file_entry->n_strings) * sizeof (char *));
+		file_entry->n_strings = index + 1;
+	}
+
+	if (file_entry->strings[index] == NULL) {
+		file_entry->strings[index] =
+			nautilus_file_get_string_attribute_with_default_q (file_entry->file,
+									   attribute);
+	}
+
+	return file_entry->strings[index];
+}
+
+static void
+nautilus_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int column, GValue *value)
+{
+	NautilusListModel *model;
+	FileEntry *file_entry;
+	NautilusFile *file;
+	GdkPixbuf *icon;
 	int icon_size;
 	NautilusZoomLevel zoom_level;
 	NautilusFileIconFlags flags;
@@ -304,46 +400,18 @@ nautilus_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int
 				}
 			}
 
-			gicon = G_ICON (nautilus_file_get_icon_pixbuf (file, icon_size, TRUE, flags));
-			emblem_icons = nautilus_file_get_emblem_icons (file);
-
-			/* pick only the first emblem we can render for the list view */
-			for (l = emblem_icons; l != NULL; l = l->next) {
-				emblem_icon = l->data;
-				if (nautilus_icon_theme_can_render (G_THEMED_ICON (emblem_icon))) {
-					emblem = g_emblem_new (emblem_icon);
-					emblemed_icon = g_emblemed_icon_new (gicon, emblem);
-
-					g_object_unref (gicon);
-					g_object_unref (emblem);
-					gicon = emblemed_icon;
-
-					break;
-				}
+			/* The drop target icon is transient, don't cache it */
+			if (flags & NAUTILUS_FILE_ICON_FLAGS_FOR_DRAG_ACCEPT) {
+				icon = render_file_icon (model, file, icon_size, flags);
+				g_value_take_object (value, icon);
+				break;
 			}
 
-			g_list_free_full (emblem_icons, g_object_unref);
-
-			icon_info = nautilus_icon_info_lookup (gicon, icon_size);
-			icon = nautilus_icon_info_get_pixbuf_at_size (icon_info, icon_size);
-
-			g_object_unref (icon_info);
-			g_object_unref (gicon);
-
-			if (model->details->highlight_files != NULL &&
-			    g_list_find_custom (model->details->highlight_files,
-			                        file, (GCompareFunc) nautilus_file_compare_location))
-			{
-				rendered_icon = eel_create_spotlight_pixbuf (icon);
-
-				if (rendered_icon != NULL) {
-					g_object_unref (icon);
-					icon = rendered_icon;
-				}
+			if (file_entry->icons[zoom_level] == NULL) {
+				file_entry->icons[zoom_level] = render_file_icon (model, file, icon_size, flags);
 			}
 
-			g_value_set_object (value, icon);
-			g_object_unref (icon);
+			g_value_set_object (value, file_entry->icons[zoom_level]);
 		}
 		break;
 	case NAUTILUS_LIST_MODEL_FILE_NAME_IS_EDITABLE_COLUMN:
@@ -353,18 +421,24 @@ nautilus_list_model_get_value (GtkTreeModel *tree_model, GtkTreeIter *iter, int
                 break;
  	default:
  		if (column >= NAUTILUS_LIST_MODEL_NUM_COLUMNS || column < NAUTILUS_LIST_MODEL_NUM_COLUMNS + model->details->columns->len) {
-			NautilusColumn *nautilus_column;
+			guint index;
 			GQuark attribute;
-			nautilus_column = model->details->columns->pdata[column - NAUTILUS_LIST_MODEL_NUM_COLUMNS];
-			
+
+			index = column - NAUTILUS_LIST_MODEL_NUM_COLUMNS;
+			attribute = g_array_index (model->details->column_attributes, GQuark, index);
+
 			g_value_init (value, G_TYPE_STRING);
-			g_object_get (nautilus_column, 
-				      "attribute_q", &attribute, 
-				      NULL);
 			if (file != NULL) {
-				str = nautilus_file_get_string_attribute_with_default_q (file, 
-											 attribute);
-				g_value_take_string (value, str);
+				/* Relative dates ("Yesterday") change without the
+				 * file changing, so always format them afresh.
+				 */
+				if (nautilus_file_is_date_sort_attribute_q (attribute)) {
+					g_value_take_string (value,
+							     nautilus_file_get_string_attribute_with_default_q (file, attribute));
+				} else {
+					g_value_set_string (value,
+							    file_entry_get_string_attribute (file_entry, index, attribute));
+				}
 			} else if (attribute == attribute_name_q) {
 				if (file_entry->parent->loaded) {
 					g_value_set_string (value, _("(Empty)"));
@@ -890,6 +964,166 @@ nautilus_list_model_add_file (NautilusListModel *model, NautilusFile *file,
 	return TRUE;
 }
 
+static int
+file_entry_ptr_compare_func (gconstpointer a,
+			     gconstpointer b,
+			     gpointer      user_data)
+{
+	return nautilus_list_model_file_entry_compare_func (*(FileEntry **) a,
+							    *(FileEntry **) b,
+							    user_data);
+}
+
+/* How far the merge walks forward before it looks up the insertion
+ * point with a binary search instead.
+ */
+#define MERGE_WALK_MAX 32
+
+/* Adds a batch of files from one directory. The batch is sorted and
+ * merged into the sequence in one pass: only the first entry's
+ * position is searched for, the rest are found by walking forward from
+ * the previous one, and into an empty sequence they are just appended.
+ * Rows are announced in ascending order. Files that are already in the
+ * model are skipped.
+ */
+void
+nautilus_list_model_add_files (NautilusListModel *model,
+			       GList *files,
+			       NautilusDirectory *directory)
+{
+	GtkTreeIter iter;
+	GtkTreePath *parent_path, *path;
+	FileEntry *parent_entry, *file_entry, *dummy_entry;
+	GSequenceIter *parent_ptr, *ptr, *dummy_ptr;
+	GSequence *sequence;
+	GHashTable *parent_hash;
+	GPtrArray *entries;
+	gboolean replace_dummy;
+	GList *l;
+	guint i, steps;
+	int position;
+
+	parent_ptr = g_hash_table_lookup (model->details->directory_reverse_map,
+					  directory);
+	if (parent_ptr != NULL) {
+		parent_entry = g_sequence_get (parent_ptr);
+		parent_hash = parent_entry->reverse_map;
+		sequence = parent_entry->files;
+	} else {
+		parent_entry = NULL;
+		parent_hash = model->details->top_reverse_map;
+		sequence = model->details->files;
+	}
+
+	entries = g_ptr_array_new ();
+	for (l = files; l != NULL; l = l->next) {
+		if (g_hash_table_lookup (parent_hash, l->data) != NULL) {
+			continue;
+		}
+
+		file_entry = g_new0 (FileEntry, 1);
+		file_entry->file = nautilus_file_ref (l->data);
+		file_entry->parent = parent_entry;
+		g_ptr_array_add (entries, file_entry);
+	}
+
+	if (entries->len == 0) {
+		g_ptr_array_free (entries, TRUE);
+		return;
+	}
+
+	g_ptr_array_sort_with_data (entries, file_entry_ptr_compare_func, model);
+
+	replace_dummy = FALSE;
+
+	if (parent_entry != NULL) {
+		/* See nautilus_list_model_add_file () */
+		parent_entry->loaded = 1;
+		if (g_sequence_get_length (sequence) == 1) {
+			dummy_ptr = g_sequence_get_begin_iter (sequence);
+			dummy_entry = g_sequence_get (dummy_ptr);
+			if (dummy_entry->file == NULL) {
+				/* replace the dummy loading entry */
+				model->details->stamp++;
+				g_sequence_remove (dummy_ptr);
+
+				replace_dummy = TRUE;
+			}
+		}
+
+		nautilus_list_model_ptr_to_iter (model, parent_ptr, &iter);
+		parent_path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), &iter);
+	} else {
+		parent_path = gtk_tree_path_new ();
+	}
+
+	ptr = NULL;
+	position = 0;
+	for (i = 0; i < entries->len; i++) {
+		file_entry = g_ptr_array_index (entries, i);
+
+		/* the same file may be in the batch twice */
+		if (g_hash_table_lookup (parent_hash, file_entry->file) != NULL) {
+			file_entry_free (file_entry);
+			continue;
+		}
+
+		if (ptr == NULL) {
+			ptr = g_sequence_search (sequence, file_entry,
+						 nautilus_list_model_file_entry_compare_func, model);
+			position = g_sequence_iter_get_position (ptr);
+		}
+
+		/* Both the batch and the sequence are sorted, so the
+		 * insertion point only moves forward. Far jumps are left
+		 * to a binary search so that small batches spread over a
+		 * big folder don't walk all of it.
+		 */
+		for (steps = 0;
+		     !g_sequence_iter_is_end (ptr) &&
+		     nautilus_list_model_file_entry_compare_func (g_sequence_get (ptr),
+								  file_entry, model) <= 0;
+		     steps++) {
+			if (steps == MERGE_WALK_MAX) {
+				ptr = g_sequence_search (sequence, file_entry,
+							 nautilus_list_model_file_entry_compare_func, model);
+				position = g_sequence_iter_get_position (ptr);
+				break;
+			}
+			ptr = g_sequence_iter_next (ptr);
+			position++;
+		}
+
+		file_entry->ptr = g_sequence_insert_before (ptr, file_entry);
+		g_hash_table_insert (parent_hash, file_entry->file, file_entry->ptr);
+
+		iter.stamp = model->details->stamp;
+		iter.user_data = file_entry->ptr;
+
+		path = gtk_tree_path_copy (parent_path);
+		gtk_tree_path_append_index (path, position++);
+		if (replace_dummy) {
+			gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, &iter);
+			replace_dummy = FALSE;
+		} else {
+			gtk_tree_model_row_inserted (GTK_TREE_MODEL (model), path, &iter);
+		}
+
+		if (nautilus_file_is_directory (file_entry->file)) {
+			file_entry->files = g_sequence_new ((GDestroyNotify)file_entry_free);
+
+			add_dummy_row (model, file_entry);
+
+			gtk_tree_model_row_has_child_toggled (GTK_TREE_MODEL (model),
+							      path, &iter);
+		}
+		gtk_tree_path_free (path);
+	}
+
+	gtk_tree_path_free (parent_path);
+	g_ptr_array_free (entries, TRUE);
+}
+
 void
 nautilus_list_model_file_changed (NautilusListModel *model, NautilusFile *file,
 				  NautilusDirectory *directory)
@@ -908,6 +1142,7 @@ nautilus_list_model_file_changed (NautilusListModel *model, NautilusFile *file,
 		return;
 	}
 
+	file_entry_invalidate_cache (g_sequence_get (ptr));
 	
 	pos_before = g_sequence_iter_get_position (ptr);
 		
@@ -1345,9 +1580,14 @@ int
 nautilus_list_model_add_column (NautilusListModel *model,
 				NautilusColumn *column)
 {
+	GQuark attribute;
+
 	g_ptr_array_add (model->details->columns, column);
 	g_object_ref (column);
 
+	g_object_get (column, "attribute_q", &attribute, NULL);
+	g_array_append_val (model->details->column_attributes, attribute);
+
 	return NAUTILUS_LIST_MODEL_NUM_COLUMNS + (model->details->columns->len - 1);
 }
 
@@ -1391,6 +1631,11 @@ nautilus_list_model_dispose (GObject *object)
 		model->details->columns = NULL;
 	}
 
+	if (model->details->column_attributes) {
+		g_array_free (model->details->column_attributes, TRUE);
+		model->details->column_attributes = NULL;
+	}
+
 	if (model->details->files) {
 		g_sequence_free (model->details->files);
 		model->details->files = NULL;
@@ -1416,7 +1661,7 @@ nautilus_list_model_finalize (GObject *object)
 	model = NAUTILUS_LIST_MODEL (object);
 
 	if (model->details->highlight_files != NULL) {
-		nautilus_file_list_free (model->details->highlight_files);
+		g_hash_table_destroy (model->details->highlight_files);
 		model->details->highlight_files = NULL;
 	}
 
@@ -1435,6 +1680,7 @@ nautilus_list_model_init (NautilusListModel *model)
 	model->details->stamp = g_random_int ();
 	model->details->sort_attribute = 0;
 	model->details->columns = g_ptr_array_new ();
+	model->details->column_attributes = g_array_new (FALSE, FALSE, sizeof (GQuark));
 }
 
 static void
@@ -1536,12 +1782,16 @@ refresh_row (gpointer data,
 	NautilusListModel *model;
 	GList *iters, *l;
 	GtkTreePath *path;
+	GtkTreeIter *iter;
 
 	model = user_data;
 	file = data;
 
 	iters = nautilus_list_model_get_all_iters_for_file (model, file);
 	for (l = iters; l != NULL; l = l->next) {
+		iter = l->data;
+		file_entry_invalidate_cache (g_sequence_get (iter->user_data));
+
 		path = gtk_tree_model_get_path (GTK_TREE_MODEL (model), l->data);
 		gtk_tree_model_row_changed (GTK_TREE_MODEL (model), path, l->data);
 
@@ -1555,17 +1805,30 @@ void
 nautilus_list_model_set_highlight_for_files (NautilusListModel *model,
 					     GList *files)
 {
-	if (model->details->highlight_files != NULL) {
-		g_list_foreach (model->details->highlight_files,
-		                refresh_row, model);
-		nautilus_file_list_free (model->details->highlight_files);
-		model->details->highlight_files = NULL;
+	GHashTable *old_highlight_files;
+	GHashTableIter hash_iter;
+	gpointer file;
+	GList *l;
+
+	old_highlight_files = model->details->highlight_files;
+	model->details->highlight_files = NULL;
+
+	if (old_highlight_files != NULL) {
+		g_hash_table_iter_init (&hash_iter, old_highlight_files);
+		while (g_hash_table_iter_next (&hash_iter, &file, NULL)) {
+			refresh_row (file, model);
+		}
+		g_hash_table_destroy (old_highlight_files);
 	}
 
 	if (files != NULL) {
-		model->details->highlight_files = nautilus_file_list_copy (files);
-		g_list_foreach (model->details->highlight_files,
-		                refresh_row, model);
-
+		model->details->highlight_files =
+			g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					       (GDestroyNotify) nautilus_file_unref, NULL);
+		for (l = files; l != NULL; l = l->next) {
+			g_hash_table_add (model->details->highlight_files,
+					  nautilus_file_ref (l->data));
+		}
+		g_list_foreach (files, refresh_row, model);
 	}
 }
@@ -62,6 +62,8 @@
 struct NautilusListViewDetails {
 	GtkTreeView *tree_view;
 	NautilusListModel *model;
+	/* add-file emissions still to come for files add_files added */
+	guint batched_files;
 	GtkActionGroup *list_action_group;
 	guint list_merge_id;
 
@@ -1796,10 +1798,29 @@ create_and_set_up_tree_view (NautilusListView *view)
 static void
 nautilus_list_view_add_file (NautilusView *view, NautilusFile *file, NautilusDirectory *directory)
 {
-	NautilusListModel *model;
+	NautilusListView *list_view;
+
+	list_view = NAUTILUS_LIST_VIEW (view);
+
+	/* Files that came in through add_files are already there */
+	if (list_view->details->batched_files > 0) {
+		list_view->details->batched_files--;
+		return;
+	}
+
+	nautilus_list_model_add_file (list_view->details->model, file, directory);
+}
+
+static void
+nautilus_list_view_add_files (NautilusView *view, GList *files, NautilusDirectory *directory)
+{
+	NautilusListView *list_view;
+
+	list_view = NAUTILUS_LIST_VIEW (view);
 
-	model = NAUTILUS_LIST_VIEW (view)->details->model;
-	nautilus_list_model_add_file (model, file, directory);
+	list_view->details->batched_files += g_list_length (files);
+	nautilus_list_model_add_files (list_view->details->model,
+				       files, directory);
 }
 
 static char **
@@ -3212,6 +3233,7 @@ nautilus_list_view_class_init (NautilusListViewClass *class)
 	G_OBJECT_CLASS (class)->finalize = nautilus_list_view_finalize;
 
 	nautilus_view_class->add_file = nautilus_list_view_add_file;
+	nautilus_view_class->add_files = nautilus_list_view_add_files;
 	nautilus_view_class->begin_loading = nautilus_list_view_begin_loading;
 	nautilus_view_class->end_loading = nautilus_list_view_end_loading;
 	nautilus_view_class->bump_zoom_level = nautilus_list_view_bump_zoom_level;
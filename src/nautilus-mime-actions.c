@@ -365,7 +365,7 @@ nautilus_mime_get_default_application_for_file (NautilusFile *file)
 	if (app == NULL) {
 		uri_scheme = nautilus_file_get_uri_scheme (file);
 		if (uri_scheme != NULL) {
-			app = g_app_info_get_default_for_uri_scheme (uri_scheme);
+			app = get_default_application_for_uri_scheme (uri_scheme);
 			g_free (uri_scheme);
 		}
 	}
@@ -373,39 +373,43 @@ nautilus_mime_get_default_application_for_file (NautilusFile *file)
 	return app;
 }
 
-static int
-file_compare_by_mime_type (NautilusFile *file_a,
-			   NautilusFile *file_b)
+/* Returns one file for each distinct combination of what the
+ * application lookups depend on: the mime type, the uri scheme and
+ * whether there is a local path.  The files are not reffed. */
+static GList *
+get_distinct_files_for_applications (GList *files)
 {
-	char *mime_type_a, *mime_type_b;
-	int ret;
-	
-	mime_type_a = nautilus_file_get_mime_type (file_a);
-	mime_type_b = nautilus_file_get_mime_type (file_b);
-	
-	ret = strcmp (mime_type_a, mime_type_b);
-	
-	g_free (mime_type_a);
-	g_free (mime_type_b);
-	
-	return ret;
-}
+	GHashTable *seen;
+	GList *l, *ret;
+	NautilusFile *file;
+	char *mime_type, *uri_scheme, *key;
 
-static int
-file_compare_by_parent_uri (NautilusFile *file_a,
-			    NautilusFile *file_b) {
-	char *parent_uri_a, *parent_uri_b;
-	int ret;
+	seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
-	parent_uri_a = nautilus_file_get_parent_uri (file_a);
-	parent_uri_b = nautilus_file_get_parent_uri (file_b);
+	ret = NULL;
+	for (l = files; l != NULL; l = l->next) {
+		file = l->data;
 
-	ret = strcmp (parent_uri_a, parent_uri_b);
+		mime_type = nautilus_file_get_mime_type (file);
+		uri_scheme = nautilus_file_get_uri_scheme (file);
+		key = g_strdup_printf ("%s %s %d", mime_type,
+				       uri_scheme ? uri_scheme : "",
+				       file_has_local_path (file));
+		g_free (mime_type);
+		g_free (uri_scheme);
 
-	g_free (parent_uri_a);
-	g_free (parent_uri_b);
+		if (g_hash_table_lookup (seen, key) != NULL) {
+			g_free (key);
+			continue;
+		}
 
-	return ret;
+		g_hash_table_insert (seen, key, file);
+		ret = g_list_prepend (ret, file);
+	}
+
+	g_hash_table_destroy (seen);
+
+	return g_list_reverse (ret);
 }
 
 static int
@@ -416,35 +420,128 @@ application_compare_by_name (const GAppInfo *app_a,
 			       g_app_info_get_name ((GAppInfo *)app_b));
 }
 
-static int
-application_compare_by_id (const GAppInfo *app_a,
-			   const GAppInfo *app_b)
+/* Looking up the applications for a content type means going through
+ * the mime caches of all application directories, and the menus do it
+ * for every selection change, so the filtered lists are kept around
+ * until the installed applications or the associations change.
+ */
+static GHashTable *mime_applications; /* content type -> GList of GAppInfo */
+static GHashTable *uri_scheme_handlers; /* uri scheme -> GAppInfo or NULL */
+static GList *application_monitors;
+
+static void
+application_list_free (GList *apps)
+{
+	g_list_free_full (apps, g_object_unref);
+}
+
+static void
+application_unref_if_not_null (gpointer app)
+{
+	if (app != NULL) {
+		g_object_unref (app);
+	}
+}
+
+static void
+application_cache_changed (GFileMonitor *monitor,
+			   GFile *file,
+			   GFile *other_file,
+			   GFileMonitorEvent event_type,
+			   gpointer user_data)
 {
-	const char *id_a, *id_b;
+	DEBUG ("Application cache flushed");
 
-	id_a = g_app_info_get_id ((GAppInfo *)app_a);
-	id_b = g_app_info_get_id ((GAppInfo *)app_b);
+	g_hash_table_remove_all (mime_applications);
+	g_hash_table_remove_all (uri_scheme_handlers);
+}
 
-	if (id_a == NULL && id_b == NULL) {
-		if (g_app_info_equal ((GAppInfo *)app_a, (GAppInfo *)app_b)) {
-			return 0;
-		}
-		if ((gsize)app_a < (gsize) app_b) {
-			return -1;
-		}
-		return 1;
+static void
+application_cache_add_monitor (const char *path,
+			       gboolean is_directory)
+{
+	GFile *file;
+	GFileMonitor *monitor;
+
+	file = g_file_new_for_path (path);
+	if (is_directory) {
+		monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, NULL);
+	} else {
+		monitor = g_file_monitor_file (file, G_FILE_MONITOR_NONE, NULL, NULL);
 	}
+	g_object_unref (file);
 
-	if (id_a == NULL) {
-		return -1;
+	if (monitor != NULL) {
+		g_signal_connect (monitor, "changed",
+				  G_CALLBACK (application_cache_changed), NULL);
+		application_monitors = g_list_prepend (application_monitors, monitor);
 	}
-	
-	if (id_b == NULL) {
-		return 1;
+}
+
+static void
+application_cache_ensure (void)
+{
+	const char * const *data_dirs;
+	char *path;
+	int i;
+
+	if (mime_applications != NULL) {
+		return;
 	}
-	
-	
-	return strcmp (id_a, id_b);
+
+	mime_applications = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+						   (GDestroyNotify) application_list_free);
+	uri_scheme_handlers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+						     application_unref_if_not_null);
+
+	path = g_build_filename (g_get_user_data_dir (), "applications", NULL);
+	application_cache_add_monitor (path, TRUE);
+	g_free (path);
+
+	data_dirs = g_get_system_data_dirs ();
+	for (i = 0; data_dirs[i] != NULL; i++) {
+		path = g_build_filename (data_dirs[i], "applications", NULL);
+		application_cache_add_monitor (path, TRUE);
+		g_free (path);
+	}
+
+	path = g_build_filename (g_get_user_config_dir (), "mimeapps.list", NULL);
+	application_cache_add_monitor (path, FALSE);
+	g_free (path);
+}
+
+static GList *
+get_applications_for_type (const char *mime_type)
+{
+	GList *apps;
+
+	application_cache_ensure ();
+
+	if (!g_hash_table_lookup_extended (mime_applications, mime_type,
+					   NULL, (gpointer *) &apps)) {
+		apps = g_app_info_get_all_for_type (mime_type);
+		apps = filter_no_show_apps (apps);
+		apps = filter_nautilus_handler (apps);
+		g_hash_table_insert (mime_applications, g_strdup (mime_type), apps);
+	}
+
+	return g_list_copy_deep (apps, (GCopyFunc) g_object_ref, NULL);
+}
+
+static GAppInfo *
+get_default_application_for_uri_scheme (const char *uri_scheme)
+{
+	GAppInfo *app;
+
+	application_cache_ensure ();
+
+	if (!g_hash_table_lookup_extended (uri_scheme_handlers, uri_scheme,
+					   NULL, (gpointer *) &app)) {
+		app = g_app_info_get_default_for_uri_scheme (uri_scheme);
+		g_hash_table_insert (uri_scheme_handlers, g_strdup (uri_scheme), app);
+	}
+
+	return app != NULL ? g_object_ref (app) : NULL;
 }
 
 GList *
@@ -459,49 +556,43 @@ nautilus_mime_get_applications_for_file (NautilusFile *file)
 		return NULL;
 	}
 	mime_type = nautilus_file_get_mime_type (file);
-	result = g_app_info_get_all_for_type (mime_type);
+	result = get_applications_for_type (mime_type);
 
 	uri_scheme = nautilus_file_get_uri_scheme (file);
 	if (uri_scheme != NULL) {
-		uri_handler = g_app_info_get_default_for_uri_scheme (uri_scheme);
+		uri_handler = get_default_application_for_uri_scheme (uri_scheme);
 		if (uri_handler) {
 			result = g_list_prepend (result, uri_handler);
+			result = filter_no_show_apps (result);
+			result = filter_nautilus_handler (result);
 		}
 		g_free (uri_scheme);
 	}
 
-	result = filter_no_show_apps (result);
-
 	/* Filter out non-uri supporting apps */
 	result = filter_non_uri_apps (result, file_has_local_path (file));
 
 	result = g_list_sort (result, (GCompareFunc) application_compare_by_name);
 	g_free (mime_type);
 
-	return filter_nautilus_handler (result);
+	return result;
 }
 
 GAppInfo *
 nautilus_mime_get_default_application_for_files (GList *files)
 {
-	GList *l, *sorted_files;
+	GList *l, *distinct_files;
 	NautilusFile *file;
 	GAppInfo *app, *one_app;
 
 	g_assert (files != NULL);
 
-	sorted_files = g_list_sort (g_list_copy (files), (GCompareFunc) file_compare_by_mime_type);
+	distinct_files = get_distinct_files_for_applications (files);
 
 	app = NULL;
-	for (l = sorted_files; l != NULL; l = l->next) {
+	for (l = distinct_files; l != NULL; l = l->next) {
 		file = l->data;
 
-		if (l->prev &&
-		    file_compare_by_mime_type (file, l->prev->data) == 0 &&
-		    file_compare_by_parent_uri (file, l->prev->data) == 0) {
-			continue;
-		}
-
 		one_app = nautilus_mime_get_default_application_for_file (file);
 		if (one_app == NULL || (app != NULL && !g_app_info_equal (app, one_app))) {
 			if (app) {
@@ -521,92 +612,86 @@ nautilus_mime_get_default_application_for_files (GList *files)
 		}
 	}
 
-	g_list_free (sorted_files);
+	g_list_free (distinct_files);
 
 	return app;
 }
 
-/* returns an intersection of two mime application lists,
- * and returns a new list, freeing a, b and all applications
- * that are not in the intersection set.
- * The lists are assumed to be pre-sorted by their IDs */
-static GList *
-intersect_application_lists (GList *a,
-			     GList *b)
+/* Applications are compared by their interned id, or by the object
+ * itself for the rare ones without an id. */
+static gconstpointer
+application_get_key (GAppInfo *app)
 {
-	GList *l, *m;
-	GList *ret;
-	GAppInfo *a_app, *b_app;
-	int cmp;
-
-	ret = NULL;
-
-	l = a;
-	m = b;
-
-	while (l != NULL && m != NULL) {
-		a_app = (GAppInfo *) l->data;
-		b_app = (GAppInfo *) m->data;
+	const char *id;
 
-		cmp = application_compare_by_id (a_app, b_app);
-		if (cmp > 0) {
-			g_object_unref (b_app);
-			m = m->next;
-		} else if (cmp < 0) {
-			g_object_unref (a_app);
-			l = l->next;
-		} else {
-			g_object_unref (b_app);
-			ret = g_list_prepend (ret, a_app);
-			l = l->next;
-			m = m->next;
-		}
+	id = g_app_info_get_id (app);
+	if (id == NULL) {
+		return app;
 	}
-
-	g_list_foreach (l, (GFunc) g_object_unref, NULL);
-	g_list_foreach (m, (GFunc) g_object_unref, NULL);
-
-	g_list_free (a);
-	g_list_free (b);
-
-	return g_list_reverse (ret);
+	return g_intern_string (id);
 }
 
 GList *
 nautilus_mime_get_applications_for_files (GList *files)
 {
-	GList *l, *sorted_files;
+	GList *l, *m, *distinct_files;
 	NautilusFile *file;
 	GList *one_ret, *ret;
+	GHashTable *common, *one_set;
+	gconstpointer key;
+	GAppInfo *app;
 
 	g_assert (files != NULL);
 
-	sorted_files = g_list_sort (g_list_copy (files), (GCompareFunc) file_compare_by_mime_type);
+	distinct_files = get_distinct_files_for_applications (files);
 
 	ret = NULL;
-	for (l = sorted_files; l != NULL; l = l->next) {
+	common = NULL;
+	for (l = distinct_files; l != NULL; l = l->next) {
 		file = l->data;
 
-		if (l->prev &&
-		    file_compare_by_mime_type (file, l->prev->data) == 0 &&
-		    file_compare_by_parent_uri (file, l->prev->data) == 0) {
-			continue;
-		}
-
 		one_ret = nautilus_mime_get_applications_for_file (file);
-		one_ret = g_list_sort (one_ret, (GCompareFunc) application_compare_by_id);
-		if (ret != NULL) {
-			ret = intersect_application_lists (ret, one_ret);
+
+		if (common == NULL) {
+			common = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
+			for (m = one_ret; m != NULL; m = m->next) {
+				g_hash_table_replace (common,
+						      (gpointer) application_get_key (m->data),
+						      g_object_ref (m->data));
+			}
 		} else {
-			ret = one_ret;
+			one_set = g_hash_table_new (NULL, NULL);
+			for (m = one_ret; m != NULL; m = m->next) {
+				g_hash_table_add (one_set, (gpointer) application_get_key (m->data));
+			}
+
+			/* Drop everything this file can't be opened with */
+			for (m = ret; m != NULL; m = m->next) {
+				key = application_get_key (m->data);
+				if (!g_hash_table_contains (one_set, key)) {
+					g_hash_table_remove (common, key);
+				}
+			}
+			g_hash_table_destroy (one_set);
 		}
 
+		g_list_free_full (one_ret, g_object_unref);
+
+		g_list_free (ret);
+		ret = g_hash_table_get_values (common);
+
 		if (ret == NULL) {
 			break;
 		}
 	}
 
-	g_list_free (sorted_files);
+	for (l = ret; l != NULL; l = l->next) {
+		g_object_ref (l->data);
+	}
+	if (common != NULL) {
+		g_hash_table_destroy (common);
+	}
+	g_list_free (distinct_files);
 
 	ret = g_list_sort (ret, (GCompareFunc) application_compare_by_name);
 	
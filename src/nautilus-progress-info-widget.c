@@ -28,12 +28,19 @@
 
 #include "nautilus-progress-info-widget.h"
 
+#include <glib/gi18n.h>
+#include <libnautilus-private/nautilus-job-scheduler.h>
+
 struct _NautilusProgressInfoWidgetPriv {
 	NautilusProgressInfo *info;
 
 	GtkWidget *status; /* GtkLabel */
 	GtkWidget *details; /* GtkLabel */
 	GtkWidget *progress_bar;
+
+	/* Only shown while the operation waits for its disk */
+	GtkWidget *pause_button; /* GtkToggleButton */
+	GtkWidget *front_button;
 };
 
 enum {
@@ -52,12 +59,33 @@ info_finished (NautilusProgressInfoWidget *self)
 	gtk_widget_destroy (GTK_WIDGET (self));
 }
 
+static void pause_toggled (GtkToggleButton *button,
+			   NautilusProgressInfoWidget *self);
+
+static void
+update_queue_buttons (NautilusProgressInfoWidget *self)
+{
+	gboolean queued, paused;
+
+	queued = nautilus_job_scheduler_is_queued (self->priv->info);
+	paused = nautilus_job_scheduler_is_paused (self->priv->info);
+
+	g_signal_handlers_block_by_func (self->priv->pause_button, pause_toggled, self);
+	gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (self->priv->pause_button), paused);
+	g_signal_handlers_unblock_by_func (self->priv->pause_button, pause_toggled, self);
+
+	gtk_widget_set_visible (self->priv->pause_button, queued);
+	gtk_widget_set_visible (self->priv->front_button, queued && !paused);
+}
+
 static void
 update_data (NautilusProgressInfoWidget *self)
 {
 	char *status, *details;
 	char *markup;
 
+	update_queue_buttons (self);
+
 	status = nautilus_progress_info_get_status (self->priv->info);
 	gtk_label_set_text (GTK_LABEL (self->priv->status), status);
 	g_free (status);
@@ -82,6 +110,26 @@ update_progress (NautilusProgressInfoWidget *self)
 	}
 }
 
+static void
+pause_toggled (GtkToggleButton *button,
+	       NautilusProgressInfoWidget *self)
+{
+	if (gtk_toggle_button_get_active (button)) {
+		nautilus_job_scheduler_pause (self->priv->info);
+	} else {
+		nautilus_job_scheduler_resume (self->priv->info);
+	}
+
+	update_queue_buttons (self);
+}
+
+static void
+front_clicked (GtkWidget *button,
+	       NautilusProgressInfoWidget *self)
+{
+	nautilus_job_scheduler_move_to_front (self->priv->info);
+}
+
 static void
 cancel_clicked (GtkWidget *button,
 		NautilusProgressInfoWidget *self)
@@ -124,6 +172,32 @@ nautilus_progress_info_widget_constructed (GObject *obj)
 			   TRUE, TRUE,
 			   0);
 
+	image = gtk_image_new_from_stock (GTK_STOCK_GOTO_TOP,
+					  GTK_ICON_SIZE_BUTTON);
+	button = gtk_button_new ();
+	gtk_widget_set_tooltip_text (button, _("Start this operation next"));
+	gtk_container_add (GTK_CONTAINER (button), image);
+	gtk_box_pack_start (GTK_BOX (hbox),
+			    button,
+			    FALSE,FALSE,
+			    0);
+	g_signal_connect (button, "clicked",
+			  G_CALLBACK (front_clicked), self);
+	self->priv->front_button = button;
+
+	image = gtk_image_new_from_stock (GTK_STOCK_MEDIA_PAUSE,
+					  GTK_ICON_SIZE_BUTTON);
+	button = gtk_toggle_button_new ();
+	gtk_widget_set_tooltip_text (button, _("Don't start this operation yet"));
+	gtk_container_add (GTK_CONTAINER (button), image);
+	gtk_box_pack_start (GTK_BOX (hbox),
+			    button,
+			    FALSE,FALSE,
+			    0);
+	g_signal_connect (button, "toggled",
+			  G_CALLBACK (pause_toggled), self);
+	self->priv->pause_button = button;
+
 	image = gtk_image_new_from_stock (GTK_STOCK_CANCEL,
 					  GTK_ICON_SIZE_BUTTON);
 	button = gtk_button_new ();
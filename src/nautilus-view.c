@@ -90,16 +90,23 @@
 #define DEBUG_FLAG NAUTILUS_DEBUG_DIRECTORY_VIEW
 #include <libnautilus-private/nautilus-debug.h>
 
-/* Minimum starting update inverval */
-#define UPDATE_INTERVAL_MIN 100
-/* Maximum update interval */
-#define UPDATE_INTERVAL_MAX 2000
-/* Amount of miliseconds the update interval is increased */
-#define UPDATE_INTERVAL_INC 250
-/* Interval at which the update interval is increased */
-#define UPDATE_INTERVAL_TIMEOUT_INTERVAL 250
-/* Milliseconds that have to pass without a change to reset the update interval */
-#define UPDATE_INTERVAL_RESET 1000
+/* Microseconds of each frame that may be spent dispatching file changes
+ * to the subclass; the rest is left for layout and painting.
+ */
+#define UPDATE_FRAME_BUDGET 8000
+/* Fewest files dispatched at once, however slow they have been so far */
+#define UPDATE_CHUNK_MIN 32
+/* Initial guess of the microseconds needed to dispatch one file */
+#define UPDATE_FILE_COST_INITIAL 50
+/* Milliseconds to wait after loading before displaying, giving the view a
+ * chance to gather (cached) deep counts.
+ */
+#define UPDATE_DONE_LOADING_DELAY 100
+/* Milliseconds before updating menus, depending on whether file changes
+ * are still being dispatched.
+ */
+#define UPDATE_MENUS_INTERVAL 100
+#define UPDATE_MENUS_INTERVAL_BUSY 1000
 
 #define SILENT_WINDOW_OPEN_LIMIT 5
 
@@ -191,10 +198,14 @@ struct NautilusViewDetails
 	guint reveal_selection_idle_id;
 
 	guint display_pending_source_id;
-	guint changes_timeout_id;
-
-	guint update_interval;
- 	guint64 last_queued;
+	guint display_pending_tick_id;
+
+	/* Update scheduler state and statistics, in microseconds */
+	guint64 update_file_cost;
+	gint64 update_pending_since;
+	gint64 update_last_latency;
+	gint64 update_max_latency;
+	guint update_frames;
 	
 	guint files_added_handler_id;
 	guint files_changed_handler_id;
@@ -204,13 +215,22 @@ struct NautilusViewDetails
 
 	guint delayed_rename_file_id;
 
-	GList *new_added_files;
-	GList *new_changed_files;
+	/* Changes not looked at yet, FileAndDirectory -> PendingChange. A file
+	 * that changes many times before being looked at has one entry.
+	 */
+	GHashTable *new_files;
 
 	GHashTable *non_ready_files;
 
-	GList *old_added_files;
-	GList *old_changed_files;
+	/* Ready files waiting to be handed to the subclass, as sets of
+	 * FileAndDirectory, and their display order which is recomputed
+	 * when the sets grow.
+	 */
+	GHashTable *old_added_files;
+	GHashTable *old_changed_files;
+	GList *old_added_order;
+	GList *old_changed_order;
+	gboolean old_files_need_sorting;
 
 	GList *pending_selection;
 
@@ -227,6 +247,8 @@ struct NautilusViewDetails
 	gboolean scripts_invalid;
 	gboolean templates_invalid;
 	gboolean templates_present;
+	gboolean open_with_menu_invalid;
+	gboolean extension_menu_invalid;
 
 	/* flag to indicate that no file updates should be dispatched to subclasses.
 	 * This is a workaround for bug #87701 that prevents the list view from
@@ -268,6 +290,11 @@ typedef struct {
 	NautilusDirectory *directory;
 } FileAndDirectory;
 
+typedef enum {
+	PENDING_CHANGE_ADDED = 1 << 0,
+	PENDING_CHANGE_CHANGED = 1 << 1
+} PendingChange;
+
 /* forward declarations */
 
 static gboolean display_selection_info_idle_callback           (gpointer              data);
@@ -290,11 +317,13 @@ static void     open_one_in_new_window                         (gpointer
 								gpointer              callback_data);
 static void     schedule_update_menus                          (NautilusView      *view);
 static void     remove_update_menus_timeout_callback           (NautilusView      *view);
+static void     action_menu_show_callback                      (GtkWidget         *menu,
+								NautilusView      *view);
 static void     schedule_update_status                          (NautilusView      *view);
 static void     remove_update_status_idle_callback             (NautilusView *view); 
-static void     reset_update_interval                          (NautilusView      *view);
-static void     schedule_idle_display_of_pending_files         (NautilusView      *view);
+static void     schedule_display_of_pending_files              (NautilusView      *view);
 static void     unschedule_display_of_pending_files            (NautilusView      *view);
+static void     clear_new_files                                (NautilusView      *view);
 static void     disconnect_model_handlers                      (NautilusView      *view);
 static void     metadata_for_directory_as_file_ready_callback  (NautilusFile         *file,
 								gpointer              callback_data);
@@ -785,35 +814,16 @@ application_launch_parameters_free (ApplicationLaunchParameters *parameters)
 	g_free (parameters);
 }			      
 
-static GList *
-file_and_directory_list_to_files (GList *fad_list)
+static FileAndDirectory *
+file_and_directory_new (NautilusFile *file, NautilusDirectory *directory)
 {
-	GList *res, *l;
 	FileAndDirectory *fad;
 
-	res = NULL;
-	for (l = fad_list; l != NULL; l = l->next) {
-		fad = l->data;
-		res = g_list_prepend (res, nautilus_file_ref (fad->file));
-	}
-	return g_list_reverse (res);
-}
-
-
-static GList *
-file_and_directory_list_from_files (NautilusDirectory *directory, GList *files)
-{
-	GList *res, *l;
-	FileAndDirectory *fad;
+	fad = g_new0 (FileAndDirectory, 1);
+	fad->directory = nautilus_directory_ref (directory);
+	fad->file = nautilus_file_ref (file);
 
-	res = NULL;
-	for (l = files; l != NULL; l = l->next) {
-		fad = g_new0 (FileAndDirectory, 1);
-		fad->directory = nautilus_directory_ref (directory);
-		fad->file = nautilus_file_ref (l->data);
-		res = g_list_prepend (res, fad);
-	}
-	return g_list_reverse (res);
+	return fad;
 }
 
 static void
@@ -2146,40 +2156,6 @@ action_location_properties_callback (GtkAction *action,
 	nautilus_file_list_free (files);
 }
 
-static gboolean
-all_files_in_trash (GList *files)
-{
-	GList *node;
-
-	/* Result is ambiguous if called on NULL, so disallow. */
-	g_return_val_if_fail (files != NULL, FALSE);
-
-	for (node = files; node != NULL; node = node->next) {
-		if (!nautilus_file_is_in_trash (NAUTILUS_FILE (node->data))) {
-			return FALSE;
-		}
-	}
-
-	return TRUE;
-}
-
-static gboolean
-all_selected_items_in_trash (NautilusView *view)
-{
-	GList *selection;
-	gboolean result;
-
-	/* If the contents share a parent directory, we need only
-	 * check that parent directory. Otherwise we have to inspect
-	 * each selected item.
-	 */
-	selection = nautilus_view_get_selection (view);
-	result = (selection == NULL) ? FALSE : all_files_in_trash (selection);
-	nautilus_file_list_free (selection);
-
-	return result;
-}
-
 static void
 action_show_hidden_files_callback (GtkAction *action,
 				   gpointer callback_data)
@@ -2618,6 +2594,23 @@ nautilus_view_init (NautilusView *view)
 				       file_and_directory_equal,
 				       (GDestroyNotify)file_and_directory_free,
 				       NULL);
+	/* Keys are freed by hand, so that the change kind of an existing
+	 * entry can be updated in place.
+	 */
+	view->details->new_files =
+		g_hash_table_new (file_and_directory_hash,
+				  file_and_directory_equal);
+	view->details->old_added_files =
+		g_hash_table_new_full (file_and_directory_hash,
+				       file_and_directory_equal,
+				       (GDestroyNotify)file_and_directory_free,
+				       NULL);
+	view->details->old_changed_files =
+		g_hash_table_new_full (file_and_directory_hash,
+				       file_and_directory_equal,
+				       (GDestroyNotify)file_and_directory_free,
+				       NULL);
+	view->details->update_file_cost = UPDATE_FILE_COST_INITIAL;
 
 	gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (view),
 					GTK_POLICY_AUTOMATIC,
@@ -2696,12 +2689,18 @@ static void
 real_unmerge_menus (NautilusView *view)
 {
 	GtkUIManager *ui_manager;
+	GtkWidget *menu;
 
 	ui_manager = nautilus_view_get_ui_manager (view);
 	if (ui_manager == NULL) {
 		return;
 	}
 
+	menu = gtk_ui_manager_get_widget (ui_manager, "/ActionMenu");
+	if (menu != NULL) {
+		g_signal_handlers_disconnect_by_func (menu, action_menu_show_callback, view);
+	}
+
 	nautilus_ui_unmerge_ui (ui_manager,
 				&view->details->dir_merge_id,
 				&view->details->dir_action_group);
@@ -2805,7 +2804,13 @@ nautilus_view_finalize (GObject *object)
 		gdk_event_free ((GdkEvent *) view->details->location_popup_event);
 	}
 
+	clear_new_files (view);
+	g_hash_table_destroy (view->details->new_files);
 	g_hash_table_destroy (view->details->non_ready_files);
+	g_list_free (view->details->old_added_order);
+	g_list_free (view->details->old_changed_order);
+	g_hash_table_destroy (view->details->old_added_files);
+	g_hash_table_destroy (view->details->old_changed_files);
 
 	G_OBJECT_CLASS (nautilus_view_parent_class)->finalize (object);
 }
@@ -3044,7 +3049,6 @@ done_loading (NautilusView *view,
 	if (window != NULL) {
 		schedule_update_menus (view);
 		schedule_update_status (view);
-		reset_update_interval (view);
 
 		selection = view->details->pending_selection;
 
@@ -3353,108 +3357,308 @@ sort_files (NautilusView *view, GList **list)
 	
 }
 
-/* Go through all the new added and changed files.
- * Put any that are not ready to load in the non_ready_files hash table.
- * Add all the rest to the old_added_files and old_changed_files lists.
- * Sort the old_*_files lists if anything was added to them.
+static void
+clear_new_files (NautilusView *view)
+{
+	GHashTableIter iter;
+	gpointer pending;
+
+	g_hash_table_iter_init (&iter, view->details->new_files);
+	while (g_hash_table_iter_next (&iter, &pending, NULL)) {
+		g_hash_table_iter_remove (&iter);
+		file_and_directory_free (pending);
+	}
+}
+
+/* Takes ownership of pending. */
+static void
+add_old_file (NautilusView *view,
+	      GHashTable *old_files,
+	      FileAndDirectory *pending)
+{
+	if (g_hash_table_contains (old_files, pending)) {
+		file_and_directory_free (pending);
+		return;
+	}
+
+	g_hash_table_add (old_files, pending);
+	view->details->old_files_need_sorting = TRUE;
+}
+
+/* Newly added files go into the old_added_files set if they're
+ * ready, and into the non_ready_files hash table if they're not.
+ * Takes ownership of pending.
  */
 static void
-process_new_files (NautilusView *view)
+process_new_added_file (NautilusView *view,
+			FileAndDirectory *pending)
 {
-	GList *new_added_files, *new_changed_files, *old_added_files, *old_changed_files;
 	GHashTable *non_ready_files;
-	GList *node, *next;
-	FileAndDirectory *pending;
 	gboolean in_non_ready;
 
-	new_added_files = view->details->new_added_files;
-	view->details->new_added_files = NULL;
-	new_changed_files = view->details->new_changed_files;
-	view->details->new_changed_files = NULL;
-
 	non_ready_files = view->details->non_ready_files;
 
-	old_added_files = view->details->old_added_files;
-	old_changed_files = view->details->old_changed_files;
-
-	/* Newly added files go into the old_added_files list if they're
-	 * ready, and into the hash table if they're not.
-	 */
-	for (node = new_added_files; node != NULL; node = next) {
-		next = node->next;
-		pending = (FileAndDirectory *)node->data;
-		in_non_ready = g_hash_table_lookup (non_ready_files, pending) != NULL;
-		if (nautilus_view_should_show_file (view, pending->file)) {
-			if (ready_to_load (pending->file)) {
-				if (in_non_ready) {
-					g_hash_table_remove (non_ready_files, pending);
-				}
-				new_added_files = g_list_delete_link (new_added_files, node);
-				old_added_files = g_list_prepend (old_added_files, pending);
-			} else {
-				if (!in_non_ready) {
-					new_added_files = g_list_delete_link (new_added_files, node);
-					g_hash_table_insert (non_ready_files, pending, pending);
-				}
+	in_non_ready = g_hash_table_lookup (non_ready_files, pending) != NULL;
+	if (nautilus_view_should_show_file (view, pending->file)) {
+		if (ready_to_load (pending->file)) {
+			if (in_non_ready) {
+				g_hash_table_remove (non_ready_files, pending);
 			}
+			add_old_file (view, view->details->old_added_files, pending);
+			return;
+		} else if (!in_non_ready) {
+			g_hash_table_insert (non_ready_files, pending, pending);
+			return;
 		}
 	}
-	file_and_directory_list_free (new_added_files);
 
-	/* Newly changed files go into the old_added_files list if they're ready
-	 * and were seen non-ready in the past, into the old_changed_files list
-	 * if they are read and were not seen non-ready in the past, and into
-	 * the hash table if they're not ready.
-	 */
-	for (node = new_changed_files; node != NULL; node = next) {
-		next = node->next;
-		pending = (FileAndDirectory *)node->data;
-		if (!still_should_show_file (view, pending->file, pending->directory) || ready_to_load (pending->file)) {
-			if (g_hash_table_lookup (non_ready_files, pending) != NULL) {
-				g_hash_table_remove (non_ready_files, pending);
-				if (still_should_show_file (view, pending->file, pending->directory)) {
-					new_changed_files = g_list_delete_link (new_changed_files, node);
-					old_added_files = g_list_prepend (old_added_files, pending);
-				}
-			} else if (nautilus_view_should_show_file (view, pending->file)) {
-				new_changed_files = g_list_delete_link (new_changed_files, node);
-				old_changed_files = g_list_prepend (old_changed_files, pending);
+	file_and_directory_free (pending);
+}
+
+/* Newly changed files go into the old_added_files set if they're ready
+ * and were seen non-ready in the past, into the old_changed_files set
+ * if they are read and were not seen non-ready in the past, and into
+ * the hash table if they're not ready.
+ * Takes ownership of pending.
+ */
+static void
+process_new_changed_file (NautilusView *view,
+			  FileAndDirectory *pending)
+{
+	GHashTable *non_ready_files;
+
+	non_ready_files = view->details->non_ready_files;
+
+	if (!still_should_show_file (view, pending->file, pending->directory) || ready_to_load (pending->file)) {
+		if (g_hash_table_lookup (non_ready_files, pending) != NULL) {
+			g_hash_table_remove (non_ready_files, pending);
+			if (still_should_show_file (view, pending->file, pending->directory)) {
+				add_old_file (view, view->details->old_added_files, pending);
+				return;
 			}
+		} else if (nautilus_view_should_show_file (view, pending->file)) {
+			add_old_file (view, view->details->old_changed_files, pending);
+			return;
 		}
 	}
-	file_and_directory_list_free (new_changed_files);
 
-	/* If any files were added to old_added_files, then resort it. */
-	if (old_added_files != view->details->old_added_files) {
-		view->details->old_added_files = old_added_files;
-		sort_files (view, &view->details->old_added_files);
+	file_and_directory_free (pending);
+}
+
+/* Go through all the new added and changed files, once per distinct
+ * file. Put any that are not ready to load in the non_ready_files hash
+ * table, and all the rest in the old_added_files and old_changed_files
+ * sets.
+ */
+static void
+process_new_files (NautilusView *view)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	FileAndDirectory *pending;
+	PendingChange change;
+
+	g_hash_table_iter_init (&iter, view->details->new_files);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		g_hash_table_iter_remove (&iter);
+
+		pending = key;
+		change = GPOINTER_TO_INT (value);
+
+		/* A file both added and changed goes through both, the
+		 * addition first.
+		 */
+		if (change == (PENDING_CHANGE_ADDED | PENDING_CHANGE_CHANGED)) {
+			process_new_added_file (view,
+						file_and_directory_new (pending->file,
+									pending->directory));
+			process_new_changed_file (view, pending);
+		} else if (change == PENDING_CHANGE_ADDED) {
+			process_new_added_file (view, pending);
+		} else {
+			process_new_changed_file (view, pending);
+		}
 	}
+}
 
-	/* Resort old_changed_files too, since file attributes
-	 * relevant to sorting could have changed.
-	 */
-	if (old_changed_files != view->details->old_changed_files) {
-		view->details->old_changed_files = old_changed_files;
-		sort_files (view, &view->details->old_changed_files);
+/* Rebuilds the display order of the old_*_files sets when they grew,
+ * since file attributes relevant to sorting could have changed too.
+ */
+static void
+sort_old_files (NautilusView *view)
+{
+	if (!view->details->old_files_need_sorting) {
+		return;
 	}
 
+	g_list_free (view->details->old_added_order);
+	view->details->old_added_order = g_hash_table_get_keys (view->details->old_added_files);
+	sort_files (view, &view->details->old_added_order);
+
+	g_list_free (view->details->old_changed_order);
+	view->details->old_changed_order = g_hash_table_get_keys (view->details->old_changed_files);
+	sort_files (view, &view->details->old_changed_order);
+
+	view->details->old_files_need_sorting = FALSE;
 }
 
+/* Detaches and returns the first n links of *list. */
+static GList *
+take_first_links (GList **list,
+		  guint n,
+		  guint *n_taken)
+{
+	GList *head, *rest;
+
+	head = *list;
+	rest = head;
+	for (*n_taken = 0; *n_taken < n && rest != NULL; (*n_taken)++) {
+		rest = rest->next;
+	}
+
+	if (rest != NULL) {
+		rest->prev->next = NULL;
+		rest->prev = NULL;
+	}
+	*list = rest;
+
+	return head;
+}
+
+/* Takes the files of the first n links of *order out of old_files.
+ * The returned list owns them.
+ */
+static GList *
+take_old_files (GHashTable *old_files,
+		GList **order,
+		guint n,
+		guint *n_taken)
+{
+	GList *head, *l;
+
+	head = take_first_links (order, n, n_taken);
+	for (l = head; l != NULL; l = l->next) {
+		g_hash_table_steal (old_files, l->data);
+	}
+
+	return head;
+}
+
+static gboolean
+selection_contains_any (NautilusView *view,
+			GList *fad_list)
+{
+	GHashTable *files;
+	GList *selection, *l;
+	gboolean result;
+
+	selection = nautilus_view_get_selection (view);
+	if (selection == NULL) {
+		return FALSE;
+	}
+
+	files = g_hash_table_new (NULL, NULL);
+	for (l = fad_list; l != NULL; l = l->next) {
+		g_hash_table_add (files, ((FileAndDirectory *) l->data)->file);
+	}
+
+	result = FALSE;
+	for (l = selection; l != NULL && !result; l = l->next) {
+		result = g_hash_table_contains (files, l->data);
+	}
+
+	g_hash_table_destroy (files);
+	nautilus_file_list_free (selection);
+
+	return result;
+}
+
+/* files_added is sorted by directory, so each directory's files can
+ * be handed to the subclass in one go.
+ */
 static void
-process_old_files (NautilusView *view)
+add_files_in_batches (NautilusView *view,
+		      GList *files_added)
+{
+	NautilusViewClass *klass;
+	NautilusDirectory *directory;
+	FileAndDirectory *pending;
+	GList *node, *batch;
+
+	klass = NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view));
+
+	batch = NULL;
+	directory = NULL;
+	for (node = files_added; node != NULL; node = node->next) {
+		pending = node->data;
+		if (batch != NULL && pending->directory != directory) {
+			batch = g_list_reverse (batch);
+			klass->add_files (view, batch, directory);
+			g_list_free (batch);
+			batch = NULL;
+		}
+
+		directory = pending->directory;
+		batch = g_list_prepend (batch, pending->file);
+	}
+
+	if (batch != NULL) {
+		batch = g_list_reverse (batch);
+		klass->add_files (view, batch, directory);
+		g_list_free (batch);
+	}
+}
+
+static guint
+get_update_backlog (NautilusView *view)
+{
+	return g_hash_table_size (view->details->new_files) +
+		g_hash_table_size (view->details->old_added_files) +
+		g_hash_table_size (view->details->old_changed_files);
+}
+
+/* Dispatches the ready files to the subclass, in chunks sized from the
+ * measured cost per file, until either everything is dispatched or the
+ * deadline passes. Returns TRUE when nothing is left.
+ */
+static gboolean
+process_old_files (NautilusView *view,
+		   gint64 deadline)
 {
 	GList *files_added, *files_changed, *node;
 	FileAndDirectory *pending;
-	GList *selection, *files;
 	gboolean send_selection_change;
+	gint64 start, now;
+	guint64 chunk_size;
+	guint n_added, n_changed;
+
+	if (g_hash_table_size (view->details->old_added_files) == 0 &&
+	    g_hash_table_size (view->details->old_changed_files) == 0) {
+		return TRUE;
+	}
+
+	sort_old_files (view);
 
-	files_added = view->details->old_added_files;
-	files_changed = view->details->old_changed_files;
-	
 	send_selection_change = FALSE;
 
-	if (files_added != NULL || files_changed != NULL) {
-		g_signal_emit (view, signals[BEGIN_FILE_CHANGES], 0);
+	g_signal_emit (view, signals[BEGIN_FILE_CHANGES], 0);
+
+	do {
+		start = g_get_monotonic_time ();
+		chunk_size = MAX (deadline - start, 0) / MAX (view->details->update_file_cost, 1);
+		chunk_size = CLAMP (chunk_size, UPDATE_CHUNK_MIN, G_MAXUINT);
+
+		files_added = take_old_files (view->details->old_added_files,
+					      &view->details->old_added_order,
+					      chunk_size, &n_added);
+		files_changed = take_old_files (view->details->old_changed_files,
+						&view->details->old_changed_order,
+						chunk_size - n_added, &n_changed);
+
+		if (files_added != NULL &&
+		    NAUTILUS_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->add_files != NULL) {
+			add_files_in_batches (view, files_added);
+		}
 
 		for (node = files_added; node != NULL; node = node->next) {
 			pending = node->data;
@@ -3470,23 +3674,23 @@ process_old_files (NautilusView *view)
 				       pending->file, pending->directory);
 		}
 
-		g_signal_emit (view, signals[END_FILE_CHANGES], 0);
-
-		if (files_changed != NULL) {
-			selection = nautilus_view_get_selection (view);
-			files = file_and_directory_list_to_files (files_changed);
-			send_selection_change = eel_g_lists_sort_and_check_for_intersection
-				(&files, &selection);
-			nautilus_file_list_free (files);
-			nautilus_file_list_free (selection);
+		if (files_changed != NULL && !send_selection_change) {
+			send_selection_change = selection_contains_any (view, files_changed);
 		}
-		
-		file_and_directory_list_free (view->details->old_added_files);
-		view->details->old_added_files = NULL;
 
-		file_and_directory_list_free (view->details->old_changed_files);
-		view->details->old_changed_files = NULL;
-	}
+		file_and_directory_list_free (files_added);
+		file_and_directory_list_free (files_changed);
+
+		/* Keep a moving average of what one file costs */
+		now = g_get_monotonic_time ();
+		view->details->update_file_cost =
+			(3 * view->details->update_file_cost +
+			 (now - start) / (n_added + n_changed)) / 4;
+	} while ((view->details->old_added_order != NULL ||
+		  view->details->old_changed_order != NULL) &&
+		 now < deadline);
+
+	g_signal_emit (view, signals[END_FILE_CHANGES], 0);
 
 	if (send_selection_change) {
 		/* Send a selection change since some file names could
@@ -3494,25 +3698,55 @@ process_old_files (NautilusView *view)
 		 */
 		nautilus_view_send_selection_change (view);
 	}
+
+	return (view->details->old_added_order == NULL &&
+		view->details->old_changed_order == NULL);
 }
 
-static void
-display_pending_files (NautilusView *view)
+/* Returns TRUE when all pending files have been displayed. */
+static gboolean
+display_pending_files (NautilusView *view,
+		       gint64 deadline)
 {
+	gint64 latency;
 
 	/* Don't dispatch any updates while the view is frozen. */
 	if (view->details->updates_frozen) {
-		return;
+		return TRUE;
 	}
 
+	view->details->update_frames++;
+
 	process_new_files (view);
-	process_old_files (view);
+	if (!process_old_files (view, deadline)) {
+		return FALSE;
+	}
+
+	if (view->details->update_pending_since != 0) {
+		latency = g_get_monotonic_time () - view->details->update_pending_since;
+		view->details->update_last_latency = latency;
+		view->details->update_max_latency = MAX (view->details->update_max_latency, latency);
+		view->details->update_pending_since = 0;
+
+		DEBUG ("Displayed pending files in %u frames, latency %" G_GINT64_FORMAT
+		       " us (max %" G_GINT64_FORMAT " us), %" G_GUINT64_FORMAT " us per file",
+		       view->details->update_frames, latency,
+		       view->details->update_max_latency,
+		       view->details->update_file_cost);
+		nautilus_profile_msg ("view updates: frames %u latency %" G_GINT64_FORMAT
+				      " max-latency %" G_GINT64_FORMAT,
+				      view->details->update_frames, latency,
+				      view->details->update_max_latency);
+		view->details->update_frames = 0;
+	}
 
 	if (view->details->model != NULL
 	    && nautilus_directory_are_all_files_seen (view->details->model)
 	    && g_hash_table_size (view->details->non_ready_files) == 0) {
 		done_loading (view, TRUE);
 	}
+
+	return TRUE;
 }
 
 void
@@ -3534,7 +3768,7 @@ nautilus_view_unfreeze_updates (NautilusView *view)
 			load_directory (view, view->details->model);
 		}
 	} else {
-		schedule_idle_display_of_pending_files (view);
+		schedule_display_of_pending_files (view);
 	}
 }
 
@@ -3606,35 +3840,70 @@ display_pending_callback (gpointer data)
 
 	view->details->display_pending_source_id = 0;
 
-	display_pending_files (view);
+	if (!display_pending_files (view, g_get_monotonic_time () + UPDATE_FRAME_BUDGET)) {
+		schedule_display_of_pending_files (view);
+	}
 
 	g_object_unref (G_OBJECT (view));
 
 	return FALSE;
 }
 
+static gboolean
+display_pending_tick_callback (GtkWidget *widget,
+			       GdkFrameClock *frame_clock,
+			       gpointer user_data)
+{
+	NautilusView *view;
+	gboolean done;
+
+	view = NAUTILUS_VIEW (widget);
+
+	g_object_ref (G_OBJECT (view));
+
+	done = display_pending_files (view, g_get_monotonic_time () + UPDATE_FRAME_BUDGET);
+	if (done) {
+		view->details->display_pending_tick_id = 0;
+	}
+
+	g_object_unref (G_OBJECT (view));
+
+	return done ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
+}
+
+/* Pending files are dispatched a frame's budget at a time from the frame
+ * clock, so that a directory that changes constantly can't starve
+ * painting. Before the view is realized there is no frame clock, so fall
+ * back to an idle.
+ */
 static void
-schedule_idle_display_of_pending_files (NautilusView *view)
+schedule_display_of_pending_files (NautilusView *view)
 {
-	/* Get rid of a pending source as it might be a timeout */
-	unschedule_display_of_pending_files (view);
+	if (view->details->display_pending_tick_id != 0 ||
+	    view->details->display_pending_source_id != 0) {
+		return;
+	}
 
-	/* We want higher priority than the idle that handles the relayout
-	   to avoid a resort on each add. But we still want to allow repaints
-	   and other hight prio events while we have pending files to show. */
-	view->details->display_pending_source_id =
-		g_idle_add_full (G_PRIORITY_DEFAULT_IDLE - 20,
-				 display_pending_callback, view, NULL);
+	if (gtk_widget_get_realized (GTK_WIDGET (view))) {
+		view->details->display_pending_tick_id =
+			gtk_widget_add_tick_callback (GTK_WIDGET (view),
+						      display_pending_tick_callback,
+						      NULL, NULL);
+	} else {
+		/* We want higher priority than the idle that handles the relayout
+		   to avoid a resort on each add. But we still want to allow repaints
+		   and other hight prio events while we have pending files to show. */
+		view->details->display_pending_source_id =
+			g_idle_add_full (G_PRIORITY_DEFAULT_IDLE - 20,
+					 display_pending_callback, view, NULL);
+	}
 }
 
 static void
 schedule_timeout_display_of_pending_files (NautilusView *view, guint interval)
 {
- 	/* No need to schedule an update if there's already one pending. */
-	if (view->details->display_pending_source_id != 0) {
- 		return;
-	}
- 
+	unschedule_display_of_pending_files (view);
+
 	view->details->display_pending_source_id =
 		g_timeout_add (interval, display_pending_callback, view);
 }
@@ -3647,14 +3916,25 @@ unschedule_display_of_pending_files (NautilusView *view)
 		g_source_remove (view->details->display_pending_source_id);
 		view->details->display_pending_source_id = 0;
 	}
+
+	if (view->details->display_pending_tick_id != 0) {
+		gtk_widget_remove_tick_callback (GTK_WIDGET (view),
+						 view->details->display_pending_tick_id);
+		view->details->display_pending_tick_id = 0;
+	}
 }
 
 static void
 queue_pending_files (NautilusView *view,
 		     NautilusDirectory *directory,
 		     GList *files,
-		     GList **pending_list)
+		     PendingChange change)
 {
+	FileAndDirectory lookup, *pending;
+	gpointer key, value;
+	GList *l;
+	guint queued;
+
 	if (files == NULL) {
 		return;
 	}
@@ -3664,94 +3944,50 @@ queue_pending_files (NautilusView *view,
 		return;
 	}
 
+	/* A file that changes again before it was looked at only needs
+	 * to be looked at once.
+	 */
+	queued = 0;
+	lookup.directory = directory;
+	for (l = files; l != NULL; l = l->next) {
+		lookup.file = l->data;
+		if (g_hash_table_lookup_extended (view->details->new_files,
+						  &lookup, &key, &value)) {
+			g_hash_table_insert (view->details->new_files, key,
+					     GINT_TO_POINTER (GPOINTER_TO_INT (value) | change));
+		} else {
+			pending = file_and_directory_new (l->data, directory);
+			g_hash_table_insert (view->details->new_files, pending,
+					     GINT_TO_POINTER (change));
+			queued++;
+		}
+	}
+
 	if (view->details->updates_frozen) {
-		view->details->updates_queued += g_list_length (files);
+		view->details->updates_queued += queued;
 		/* Mark the directory for reload when there are too much queued
-		 * changes to prevent the pending list from growing infinitely.
+		 * changes to prevent the pending files from growing infinitely.
 		 */
 		if (view->details->updates_queued > MAX_QUEUED_UPDATES) {
 			view->details->needs_reload = TRUE;
+			clear_new_files (view);
 			return;
 		}
 	}
 
-	
-
-	*pending_list = g_list_concat (file_and_directory_list_from_files (directory, files),
-				       *pending_list);
-
-	if (! view->details->loading || nautilus_directory_are_all_files_seen (directory)) {
-		schedule_timeout_display_of_pending_files (view, view->details->update_interval);
-	}
-}
-
-static void
-remove_changes_timeout_callback (NautilusView *view) 
-{
-	if (view->details->changes_timeout_id != 0) {
-		g_source_remove (view->details->changes_timeout_id);
-		view->details->changes_timeout_id = 0;
-	}
-}
-
-static void
-reset_update_interval (NautilusView *view)
-{
-	view->details->update_interval = UPDATE_INTERVAL_MIN;
-	remove_changes_timeout_callback (view);
-	/* Reschedule a pending timeout to idle */
-	if (view->details->display_pending_source_id != 0) {
-		schedule_idle_display_of_pending_files (view);
+	if (queued == 0) {
+		return;
 	}
-}
-
-static gboolean
-changes_timeout_callback (gpointer data)
-{
-	gint64 now;
-	gint64 time_delta;
-	gboolean ret;
-	NautilusView *view;
-
-	view = NAUTILUS_VIEW (data);
 
-	g_object_ref (G_OBJECT (view));
-
-	now = g_get_monotonic_time ();
-	time_delta = now - view->details->last_queued;
-
-	if (time_delta < UPDATE_INTERVAL_RESET*1000) {
-		if (view->details->update_interval < UPDATE_INTERVAL_MAX &&
-		    view->details->loading) {
-			/* Increase */
-			view->details->update_interval += UPDATE_INTERVAL_INC;
-		}
-		ret = TRUE;
-	} else {
-		/* Reset */
-		reset_update_interval (view);
-		ret = FALSE;
+	if (view->details->update_pending_since == 0) {
+		view->details->update_pending_since = g_get_monotonic_time ();
 	}
 
-	g_object_unref (G_OBJECT (view));
-
-	return ret;
-}
-
-static void
-schedule_changes (NautilusView *view)
-{
-	/* Remember when the change was queued */
-	view->details->last_queued = g_get_monotonic_time ();
+	DEBUG ("Queued %u files, backlog %u", queued, get_update_backlog (view));
 
-	/* No need to schedule if there are already changes pending or during loading */
-	if (view->details->changes_timeout_id != 0 ||
-	    view->details->loading) {
-		return;
+	if (! view->details->loading || nautilus_directory_are_all_files_seen (directory)) {
+		schedule_display_of_pending_files (view);
 	}
-
-	view->details->changes_timeout_id = 
-		g_timeout_add (UPDATE_INTERVAL_TIMEOUT_INTERVAL, changes_timeout_callback, view);
 }
 
 static void
@@ -3773,9 +4009,11 @@ files_added_callback (NautilusDirectory *directory,
 		     window, uri ? uri : "(no directory)");
 	g_free (uri);
 
-	schedule_changes (view);
+	/* Get the icons decoded while the files wait to be displayed */
+	nautilus_file_list_preload_icons (files,
+					  nautilus_get_icon_size_for_zoom_level (nautilus_view_get_zoom_level (view)));
 
-	queue_pending_files (view, directory, files, &view->details->new_added_files);
+	queue_pending_files (view, directory, files, PENDING_CHANGE_ADDED);
 
 	/* The number of items could have changed */
 	schedule_update_status (view);
@@ -3800,9 +4038,7 @@ files_changed_callback (NautilusDirectory *directory,
 		     window, uri ? uri : "(no directory)");
 	g_free (uri);
 
-	schedule_changes (view);
-
-	queue_pending_files (view, directory, files, &view->details->new_changed_files);
+	queue_pending_files (view, directory, files, PENDING_CHANGE_CHANGED);
 	
 	/* The free space or the number of items could have changed */
 	schedule_update_status (view);
@@ -3824,12 +4060,11 @@ done_loading_callback (NautilusDirectory *directory,
 	nautilus_profile_start (NULL);
 	process_new_files (view);
 	if (g_hash_table_size (view->details->non_ready_files) == 0) {
-		/* Unschedule a pending update and schedule a new one with the minimal
-		 * update interval. This gives the view a short chance at gathering the
+		/* Unschedule a pending update and schedule a new one after a
+		 * short delay. This gives the view a short chance at gathering the
 		 * (cached) deep counts.
 		 */
-		unschedule_display_of_pending_files (view);
-		schedule_timeout_display_of_pending_files (view, UPDATE_INTERVAL_MIN);
+		schedule_timeout_display_of_pending_files (view, UPDATE_DONE_LOADING_DELAY);
 	}
 	nautilus_profile_end (NULL);
 }
@@ -3990,112 +4225,42 @@ offset_drop_points (GArray *relative_item_points,
 	for (index = 0; index < relative_item_points->len; index++) {
 		g_array_index (relative_item_points, GdkPoint, index).x += x_offset;
 		g_array_index (relative_item_points, GdkPoint, index).y += y_offset;
-	}
-}
-
-static void
-nautilus_view_create_links_for_files (NautilusView *view, GList *files,
-				      GArray *relative_item_points)
-{
-	GList *uris;
-	char *dir_uri;
-	CopyMoveDoneData *copy_move_done_data;
-	g_assert (relative_item_points->len == 0
-		  || g_list_length (files) == relative_item_points->len);
-	
-        g_assert (NAUTILUS_IS_VIEW (view));
-        g_assert (files != NULL);
-
-	/* create a list of URIs */
-	uris = NULL;
-	g_list_foreach (files, prepend_uri_one, &uris);
-	uris = g_list_reverse (uris);
-
-        g_assert (g_list_length (uris) == g_list_length (files));
-
-	/* offset the drop locations a bit so that we don't pile
-	 * up the icons on top of each other
-	 */
-	offset_drop_points (relative_item_points,
-			    DUPLICATE_HORIZONTAL_ICON_OFFSET,
-			    DUPLICATE_VERTICAL_ICON_OFFSET);
-
-        copy_move_done_data = pre_copy_move (view);
-	dir_uri = nautilus_view_get_backing_uri (view);
-	nautilus_file_operations_copy_move (uris, relative_item_points, dir_uri, GDK_ACTION_LINK, 
-					    GTK_WIDGET (view), copy_move_done_callback, copy_move_done_data);
-	g_free (dir_uri);
-	g_list_free_full (uris, g_free);
-}
-
-/* special_link_in_selection
- * 
- * Return TRUE if one of our special links is in the selection.
- * Special links include the following: 
- *	 NAUTILUS_DESKTOP_LINK_TRASH, NAUTILUS_DESKTOP_LINK_HOME, NAUTILUS_DESKTOP_LINK_MOUNT
- */
- 
-static gboolean
-special_link_in_selection (NautilusView *view)
-{
-	gboolean saw_link;
-	GList *selection, *node;
-	NautilusFile *file;
-
-	g_return_val_if_fail (NAUTILUS_IS_VIEW (view), FALSE);
-
-	saw_link = FALSE;
-
-	selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
-
-	for (node = selection; node != NULL; node = node->next) {
-		file = NAUTILUS_FILE (node->data);
-
-		saw_link = NAUTILUS_IS_DESKTOP_ICON_FILE (file);
-		
-		if (saw_link) {
-			break;
-		}
-	}
-	
-	nautilus_file_list_free (selection);
-	
-	return saw_link;
+	}
 }
 
-/* desktop_or_home_dir_in_selection
- * 
- * Return TRUE if either the desktop or the home directory is in the selection.
- */
- 
-static gboolean
-desktop_or_home_dir_in_selection (NautilusView *view)
+static void
+nautilus_view_create_links_for_files (NautilusView *view, GList *files,
+				      GArray *relative_item_points)
 {
-	gboolean saw_desktop_or_home_dir;
-	GList *selection, *node;
-	NautilusFile *file;
-
-	g_return_val_if_fail (NAUTILUS_IS_VIEW (view), FALSE);
+	GList *uris;
+	char *dir_uri;
+	CopyMoveDoneData *copy_move_done_data;
+	g_assert (relative_item_points->len == 0
+		  || g_list_length (files) == relative_item_points->len);
+	
+        g_assert (NAUTILUS_IS_VIEW (view));
+        g_assert (files != NULL);
 
-	saw_desktop_or_home_dir = FALSE;
+	/* create a list of URIs */
+	uris = NULL;
+	g_list_foreach (files, prepend_uri_one, &uris);
+	uris = g_list_reverse (uris);
 
-	selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
+        g_assert (g_list_length (uris) == g_list_length (files));
 
-	for (node = selection; node != NULL; node = node->next) {
-		file = NAUTILUS_FILE (node->data);
+	/* offset the drop locations a bit so that we don't pile
+	 * up the icons on top of each other
+	 */
+	offset_drop_points (relative_item_points,
+			    DUPLICATE_HORIZONTAL_ICON_OFFSET,
+			    DUPLICATE_VERTICAL_ICON_OFFSET);
 
-		saw_desktop_or_home_dir =
-			nautilus_file_is_home (file)
-			|| nautilus_file_is_desktop_directory (file);
-		
-		if (saw_desktop_or_home_dir) {
-			break;
-		}
-	}
-	
-	nautilus_file_list_free (selection);
-	
-	return saw_desktop_or_home_dir;
+        copy_move_done_data = pre_copy_move (view);
+	dir_uri = nautilus_view_get_backing_uri (view);
+	nautilus_file_operations_copy_move (uris, relative_item_points, dir_uri, GDK_ACTION_LINK, 
+					    GTK_WIDGET (view), copy_move_done_callback, copy_move_done_data);
+	g_free (dir_uri);
+	g_list_free_full (uris, g_free);
 }
 
 static void
@@ -7407,6 +7572,7 @@ real_merge_menus (NautilusView *view)
 	GtkActionGroup *action_group;
 	GtkUIManager *ui_manager;
 	GtkAction *action;
+	GtkWidget *menu;
 	char *tooltip;
 
 	ui_manager = nautilus_view_get_ui_manager (view);
@@ -7437,9 +7603,17 @@ real_merge_menus (NautilusView *view)
 	g_object_unref (action_group); /* owned by ui manager */
 
 	view->details->dir_merge_id = gtk_ui_manager_add_ui_from_resource (ui_manager, "/org/gnome/nautilus/nautilus-directory-view-ui.xml", NULL);
+
+	menu = gtk_ui_manager_get_widget (ui_manager, "/ActionMenu");
+	if (menu != NULL) {
+		g_signal_connect_object (menu, "show",
+					 G_CALLBACK (action_menu_show_callback), view, 0);
+	}
 	
 	view->details->scripts_invalid = TRUE;
 	view->details->templates_invalid = TRUE;
+	view->details->open_with_menu_invalid = TRUE;
+	view->details->extension_menu_invalid = TRUE;
 }
 
 
@@ -8346,40 +8520,186 @@ clipboard_changed_callback (NautilusClipboardMonitor *monitor, NautilusView *vie
 	
 }
 
-static gboolean
-can_delete_all (GList *files)
+/* What the menus need to know about the selection, gathered in a
+ * single walk over it.
+ */
+typedef struct {
+	int count;
+	gboolean can_delete_all;
+	gboolean can_trash_all;
+	gboolean all_in_trash;
+	gboolean contains_special_link;
+	gboolean contains_desktop_or_home_dir;
+} SelectionSummary;
+
+static void
+summarize_selection (GList *selection,
+		     SelectionSummary *summary)
 {
 	NautilusFile *file;
 	GList *l;
 
-	for (l = files; l != NULL; l = l->next) {
-		file = l->data;
-		if (!nautilus_file_can_delete (file)) {
-			return FALSE;
+	summary->count = 0;
+	summary->can_delete_all = TRUE;
+	summary->can_trash_all = TRUE;
+	summary->all_in_trash = selection != NULL;
+	summary->contains_special_link = FALSE;
+	summary->contains_desktop_or_home_dir = FALSE;
+
+	for (l = selection; l != NULL; l = l->next) {
+		file = NAUTILUS_FILE (l->data);
+
+		summary->count++;
+
+		if (summary->can_delete_all && !nautilus_file_can_delete (file)) {
+			summary->can_delete_all = FALSE;
+		}
+		if (summary->can_trash_all && !nautilus_file_can_trash (file)) {
+			summary->can_trash_all = FALSE;
+		}
+		if (summary->all_in_trash && !nautilus_file_is_in_trash (file)) {
+			summary->all_in_trash = FALSE;
+		}
+		if (NAUTILUS_IS_DESKTOP_ICON_FILE (file)) {
+			summary->contains_special_link = TRUE;
+		}
+		if (!summary->contains_desktop_or_home_dir &&
+		    (nautilus_file_is_home (file) ||
+		     nautilus_file_is_desktop_directory (file))) {
+			summary->contains_desktop_or_home_dir = TRUE;
 		}
 	}
-	return TRUE;
 }
 
-static gboolean
-can_trash_all (GList *files)
+static void
+update_open_action (NautilusView *view,
+		    GList *selection)
 {
-	NautilusFile *file;
+	GtkAction *action;
 	GList *l;
+	char *label_with_underscore;
+	gboolean show_app, show_run;
+	GAppInfo *app;
+	GIcon *app_icon;
+	GtkWidget *menuitem;
 
-	for (l = files; l != NULL; l = l->next) {
-		file = l->data;
-		if (!nautilus_file_can_trash (file)) {
-			return FALSE;
+	action = gtk_action_group_get_action (view->details->dir_action_group,
+					      NAUTILUS_ACTION_OPEN);
+
+	show_app = show_run = selection != NULL;
+
+	for (l = selection; l != NULL; l = l->next) {
+		NautilusFile *file;
+
+		file = NAUTILUS_FILE (l->data);
+
+		if (!nautilus_mime_file_opens_in_external_app (file)) {
+			show_app = FALSE;
+		}
+
+		if (!nautilus_mime_file_launches (file)) {
+			show_run = FALSE;
+		}
+
+		if (!show_app && !show_run) {
+			break;
 		}
+	} 
+
+	label_with_underscore = NULL;
+
+	app = NULL;
+	app_icon = NULL;
+
+	if (show_app) {
+		app = nautilus_mime_get_default_application_for_files (selection);
 	}
-	return TRUE;
+
+	if (app != NULL) {
+		char *escaped_app;
+
+		escaped_app = eel_str_double_underscores (g_app_info_get_name (app));
+		label_with_underscore = g_strdup_printf (_("_Open With %s"),
+							 escaped_app);
+
+		app_icon = g_app_info_get_icon (app);
+		if (app_icon != NULL) {
+			g_object_ref (app_icon);
+		}
+
+		g_free (escaped_app);
+		g_object_unref (app);
+	} else if (show_run) {
+		label_with_underscore = g_strdup (_("Run"));
+	} else {
+		label_with_underscore = g_strdup (_("_Open"));
+	}
+
+	g_object_set (action, "label", label_with_underscore, NULL);
+	g_free (label_with_underscore);
+
+	menuitem = gtk_ui_manager_get_widget (
+					      nautilus_view_get_ui_manager (view),
+					      NAUTILUS_VIEW_POPUP_PATH_OPEN);
+
+	/* Only force displaying the icon if it is an application icon */
+	gtk_image_menu_item_set_always_show_image (
+						   GTK_IMAGE_MENU_ITEM (menuitem), app_icon != NULL);
+
+	if (app_icon == NULL) {
+		app_icon = g_themed_icon_new (GTK_STOCK_OPEN);
+	}
+
+	gtk_action_set_gicon (action, app_icon);
+	g_object_unref (app_icon);
+}
+
+/* Brings the parts of the menus that real_update_menus() leaves for
+ * later up to date, called right before a menu is shown.
+ */
+static void
+update_lazy_menus (NautilusView *view)
+{
+	GList *selection;
+
+	nautilus_window_update_extension_menus (nautilus_view_get_window (view));
+
+	if (!view->details->open_with_menu_invalid &&
+	    !view->details->extension_menu_invalid) {
+		return;
+	}
+
+	selection = nautilus_view_get_selection (view);
+
+	if (view->details->open_with_menu_invalid) {
+		update_open_action (view, selection);
+		reset_open_with_menu (view, selection);
+		view->details->open_with_menu_invalid = FALSE;
+	}
+
+	if (view->details->extension_menu_invalid) {
+		reset_extension_actions_menu (view, selection);
+		view->details->extension_menu_invalid = FALSE;
+	}
+
+	nautilus_file_list_free (selection);
+}
+
+static void
+action_menu_show_callback (GtkWidget *menu,
+			   NautilusView *view)
+{
+	update_menus_if_pending (view);
+	update_lazy_menus (view);
+
+	/* The menu is about to appear, don't wait for the idle rebuild */
+	gtk_ui_manager_ensure_update (nautilus_view_get_ui_manager (view));
 }
 
 static void
 real_update_menus (NautilusView *view)
 {
-	GList *selection, *l;
+	GList *selection;
 	gint selection_count;
 	const char *tip, *label;
 	char *label_with_underscore;
@@ -8396,31 +8716,29 @@ real_update_menus (NautilusView *view)
 	gboolean show_open_alternate;
 	gboolean show_open_in_new_tab;
 	gboolean can_open;
-	gboolean show_app, show_run;
 	gboolean show_save_search;
 	gboolean save_search_sensitive;
 	gboolean show_save_search_as;
 	GtkAction *action;
-	GAppInfo *app;
-	GIcon *app_icon;
-	GtkWidget *menuitem;
 	gboolean show_properties;
+	SelectionSummary summary;
 
 	selection = nautilus_view_get_selection (view);
-	selection_count = g_list_length (selection);
+	summarize_selection (selection, &summary);
+	selection_count = summary.count;
 
-	selection_contains_special_link = special_link_in_selection (view);
-	selection_contains_desktop_or_home_dir = desktop_or_home_dir_in_selection (view);
+	selection_contains_special_link = summary.contains_special_link;
+	selection_contains_desktop_or_home_dir = summary.contains_desktop_or_home_dir;
 	selection_contains_recent = showing_recent_directory (view);
 
 	can_create_files = nautilus_view_supports_creating_files (view);
 	can_delete_files =
-		can_delete_all (selection) &&
+		summary.can_delete_all &&
 		selection_count != 0 &&
 		!selection_contains_special_link &&
 		!selection_contains_desktop_or_home_dir;
 	can_trash_files =
-		can_trash_all (selection) &&
+		summary.can_trash_all &&
 		selection_count != 0 &&
 		!selection_contains_special_link &&
 		!selection_contains_desktop_or_home_dir;
@@ -8472,73 +8790,7 @@ real_update_menus (NautilusView *view)
 					      NAUTILUS_ACTION_OPEN);
 	gtk_action_set_sensitive (action, selection_count != 0);
 	
-	can_open = show_app = show_run = selection_count != 0;
-
-	for (l = selection; l != NULL; l = l->next) {
-		NautilusFile *file;
-
-		file = NAUTILUS_FILE (selection->data);
-
-		if (!nautilus_mime_file_opens_in_external_app (file)) {
-			show_app = FALSE;
-		}
-
-		if (!nautilus_mime_file_launches (file)) {
-			show_run = FALSE;
-		}
-
-		if (!show_app && !show_run) {
-			break;
-		}
-	} 
-
-	label_with_underscore = NULL;
-
-	app = NULL;
-	app_icon = NULL;
-
-	if (can_open && show_app) {
-		app = nautilus_mime_get_default_application_for_files (selection);
-	}
-
-	if (app != NULL) {
-		char *escaped_app;
-
-		escaped_app = eel_str_double_underscores (g_app_info_get_name (app));
-		label_with_underscore = g_strdup_printf (_("_Open With %s"),
-							 escaped_app);
-
-		app_icon = g_app_info_get_icon (app);
-		if (app_icon != NULL) {
-			g_object_ref (app_icon);
-		}
-
-		g_free (escaped_app);
-		g_object_unref (app);
-	} else if (show_run) {
-		label_with_underscore = g_strdup (_("Run"));
-	} else {
-		label_with_underscore = g_strdup (_("_Open"));
-	}
-
-	g_object_set (action, "label", label_with_underscore, NULL);
-	g_free (label_with_underscore);
-
-	menuitem = gtk_ui_manager_get_widget (
-					      nautilus_view_get_ui_manager (view),
-					      NAUTILUS_VIEW_POPUP_PATH_OPEN);
-
-	/* Only force displaying the icon if it is an application icon */
-	gtk_image_menu_item_set_always_show_image (
-						   GTK_IMAGE_MENU_ITEM (menuitem), app_icon != NULL);
-
-	if (app_icon == NULL) {
-		app_icon = g_themed_icon_new (GTK_STOCK_OPEN);
-	}
-
-	gtk_action_set_gicon (action, app_icon);
-	g_object_unref (app_icon);
-
+	can_open = selection_count != 0;
 	gtk_action_set_visible (action, can_open);
 
 	show_open_alternate = file_list_all_are_folders (selection) &&
@@ -8585,11 +8837,13 @@ real_update_menus (NautilusView *view)
 		      NULL);
 	g_free (label_with_underscore);
 
-	/* Broken into its own function just for convenience */
-	reset_open_with_menu (view, selection);
-	reset_extension_actions_menu (view, selection);
+	/* Looking up applications and asking the extensions is
+	 * expensive, so that waits until a menu is actually shown.
+	 */
+	view->details->open_with_menu_invalid = TRUE;
+	view->details->extension_menu_invalid = TRUE;
 
-	if (all_selected_items_in_trash (view)) {
+	if (summary.all_in_trash) {
 		label = _("_Delete Permanently");
 		tip = _("Delete all selected items permanently");
 		show_separate_delete_command = FALSE;
@@ -8604,7 +8858,7 @@ real_update_menus (NautilusView *view)
 	g_object_set (action,
 		      "label", label,
 		      "tooltip", tip,
-		      "icon-name", all_selected_items_in_trash (view) ?
+		      "icon-name", summary.all_in_trash ?
 		      NAUTILUS_ICON_DELETE : NAUTILUS_ICON_TRASH_FULL,
 		      NULL);
 	/* if the backend supports delete but not trash then don't show trash */
@@ -8782,6 +9036,7 @@ nautilus_view_pop_up_selection_context_menu  (NautilusView *view,
 	 * etc. states by forcing menus to update now.
 	 */
 	update_menus_if_pending (view);
+	update_lazy_menus (view);
 
 	update_context_menu_position_from_event (view, event);
 
@@ -8809,6 +9064,7 @@ nautilus_view_pop_up_background_context_menu (NautilusView *view,
 	 * etc. states by forcing menus to update now.
 	 */
 	update_menus_if_pending (view);
+	update_lazy_menus (view);
 
 	update_context_menu_position_from_event (view, event);
 
@@ -8935,10 +9191,14 @@ schedule_update_menus (NautilusView *view)
 	
 	view->details->menu_states_untrustworthy = TRUE;
 
-	/* Schedule a menu update with the current update interval */
+	/* Schedule a menu update, later if file changes are still being
+	 * dispatched since those are likely to invalidate the menus again.
+	 */
 	if (view->details->update_menus_timeout_id == 0) {
 		view->details->update_menus_timeout_id
-			= g_timeout_add (view->details->update_interval, update_menus_timeout_callback, view);
+			= g_timeout_add (view->details->update_pending_since != 0 ?
+					 UPDATE_MENUS_INTERVAL_BUSY : UPDATE_MENUS_INTERVAL,
+					 update_menus_timeout_callback, view);
 	}
 }
 
@@ -8984,6 +9244,22 @@ schedule_update_status (NautilusView *view)
 	}
 }
 
+/* A single selected folder is likely to be opened next */
+static void
+prefetch_selection (GList *selection)
+{
+	GList *locations;
+
+	if (selection == NULL || selection->next != NULL ||
+	    !nautilus_file_is_directory (selection->data)) {
+		return;
+	}
+
+	locations = g_list_prepend (NULL, nautilus_file_get_location (selection->data));
+	nautilus_directory_prefetch (locations);
+	g_list_free_full (locations, g_object_unref);
+}
+
 /**
  * nautilus_view_notify_selection_changed:
  * 
@@ -9003,6 +9279,7 @@ nautilus_view_notify_selection_changed (NautilusView *view)
 	selection = nautilus_view_get_selection (view);
 	window = nautilus_view_get_containing_window (view);
 	DEBUG_FILES (selection, "Selection changed in window %p", window);
+	prefetch_selection (selection);
 	nautilus_file_list_free (selection);
 
 	view->details->selection_was_removed = FALSE;
@@ -9027,7 +9304,10 @@ nautilus_view_notify_selection_changed (NautilusView *view)
 		 * such as rubberband-selecting in icon view.
 		 */
 
-		/* Schedule an update of menu item states to match selection */
+		/* Schedule an update of menu item states to match selection,
+		 * pushing it back while the selection keeps changing.
+		 */
+		remove_update_menus_timeout_callback (view);
 		schedule_update_menus (view);
 	}
 }
@@ -9037,8 +9317,6 @@ file_changed_callback (NautilusFile *file, gpointer callback_data)
 {
 	NautilusView *view = NAUTILUS_VIEW (callback_data);
 
-	schedule_changes (view);
-
 	schedule_update_menus (view);
 	schedule_update_status (view);
 }
@@ -9148,12 +9426,11 @@ finish_loading (NautilusView *view)
 	nautilus_window_view_visible  (nautilus_view_get_window (view), NAUTILUS_VIEW (view));
 
 	if (nautilus_directory_are_all_files_seen (view->details->model)) {
-		/* Unschedule a pending update and schedule a new one with the minimal
-		 * update interval. This gives the view a short chance at gathering the
+		/* Unschedule a pending update and schedule a new one after a
+		 * short delay. This gives the view a short chance at gathering the
 		 * (cached) deep counts.
 		 */
-		unschedule_display_of_pending_files (view);
-		schedule_timeout_display_of_pending_files (view, UPDATE_INTERVAL_MIN);
+		schedule_timeout_display_of_pending_files (view, UPDATE_DONE_LOADING_DELAY);
 	}
 	
 	/* Start loading. */
@@ -9319,22 +9596,23 @@ nautilus_view_stop_loading (NautilusView *view)
 	g_return_if_fail (NAUTILUS_IS_VIEW (view));
 
 	unschedule_display_of_pending_files (view);
-	reset_update_interval (view);
+	view->details->update_pending_since = 0;
+	view->details->update_frames = 0;
 
 	/* Free extra undisplayed files */
-	file_and_directory_list_free (view->details->new_added_files);
-	view->details->new_added_files = NULL;
-
-	file_and_directory_list_free (view->details->new_changed_files);
-	view->details->new_changed_files = NULL;
+	clear_new_files (view);
 
 	g_hash_table_foreach_remove (view->details->non_ready_files, remove_all, NULL);
 
-	file_and_directory_list_free (view->details->old_added_files);
-	view->details->old_added_files = NULL;
+	g_list_free (view->details->old_added_order);
+	view->details->old_added_order = NULL;
+	g_hash_table_remove_all (view->details->old_added_files);
+
+	g_list_free (view->details->old_changed_order);
+	view->details->old_changed_order = NULL;
+	g_hash_table_remove_all (view->details->old_changed_files);
 
-	file_and_directory_list_free (view->details->old_changed_files);
-	view->details->old_changed_files = NULL;
+	view->details->old_files_need_sorting = FALSE;
 
 	g_list_free_full (view->details->pending_selection, g_object_unref);
 	view->details->pending_selection = NULL;
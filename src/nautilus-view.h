@@ -125,6 +125,17 @@ struct NautilusViewClass {
 
 	/* Function pointers that don't have corresponding signals */
 
+	/* add_files is a function pointer that subclasses may override
+	 * to add a batch of files from one directory at once. It is
+	 * called before the 'add_file' signal is emitted once for each
+	 * of the files passed, so the 'add_file' handler must then skip
+	 * that many files. By default it is NULL and files are only
+	 * added one at a time.
+	 */
+	void	(* add_files)			(NautilusView *view,
+						 GList *files,
+						 NautilusDirectory *directory);
+
         /* reset_to_defaults is a function pointer that subclasses must 
          * override to set sort order, zoom level, etc to match default
          * values. 
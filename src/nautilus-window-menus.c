@@ -846,8 +846,8 @@ add_extension_menu_items (NautilusWindow *window,
 	}
 }
 
-void
-nautilus_window_load_extension_menus (NautilusWindow *window)
+static void
+reload_extension_menus (NautilusWindow *window)
 {
 	GtkActionGroup *action_group;
 	GList *items;
@@ -882,3 +882,21 @@ nautilus_window_load_extension_menus (NautilusWindow *window)
 		g_list_free (items);
 	}
 }
+
+/* The menu providers are asked for their items, which may load their
+ * modules, only once a menu that shows them is about to appear.
+ */
+void
+nautilus_window_invalidate_extension_menus (NautilusWindow *window)
+{
+	window->details->extensions_menu_invalid = TRUE;
+}
+
+void
+nautilus_window_update_extension_menus (NautilusWindow *window)
+{
+	if (window->details->extensions_menu_invalid) {
+		window->details->extensions_menu_invalid = FALSE;
+		reload_extension_menus (window);
+	}
+}
@@ -43,6 +43,7 @@ struct NautilusWindowDetails
         /* Menus. */
         guint extensions_menu_merge_id;
         GtkActionGroup *extensions_menu_action_group;
+        gboolean extensions_menu_invalid;
 
         GtkWidget *notebook;
 
@@ -89,7 +90,7 @@ struct NautilusWindowDetails
 typedef void (*NautilusBookmarkFailedCallback) (NautilusWindow *window,
                                                 NautilusBookmark *bookmark);
 
-void               nautilus_window_load_extension_menus                  (NautilusWindow    *window);
+void               nautilus_window_invalidate_extension_menus            (NautilusWindow    *window);
 
 void                 nautilus_window_set_active_slot                     (NautilusWindow    *window,
 									  NautilusWindowSlot *slot);
@@ -475,7 +475,7 @@ real_active (NautilusWindowSlot *slot)
 
 	if (slot->details->viewed_file != NULL) {
 		nautilus_window_slot_sync_view_as_menus (slot);
-		nautilus_window_load_extension_menus (window);
+		nautilus_window_invalidate_extension_menus (window);
 	}
 }
 
@@ -2158,7 +2158,7 @@ nautilus_window_slot_update_for_new_location (NautilusWindowSlot *slot)
 		nautilus_window_slot_sync_view_as_menus (slot);
 
 		/* Load menus from nautilus extensions for this location */
-		nautilus_window_load_extension_menus (window);
+		nautilus_window_invalidate_extension_menus (window);
 	}
 
 	if (location_really_changed) {
@@ -2211,6 +2211,36 @@ nautilus_window_slot_update_for_new_location (NautilusWindowSlot *slot)
 	}
 }
 
+/* Guess where the user is going next: up, back or forward */
+static void
+prefetch_neighbours (NautilusWindowSlot *slot)
+{
+	GList *locations;
+	GFile *location;
+
+	locations = NULL;
+
+	location = nautilus_window_slot_get_location (slot);
+	if (location != NULL) {
+		location = g_file_get_parent (location);
+		if (location != NULL) {
+			locations = g_list_prepend (locations, location);
+		}
+	}
+
+	if (slot->details->back_list != NULL) {
+		locations = g_list_prepend (locations,
+					    nautilus_bookmark_get_location (slot->details->back_list->data));
+	}
+	if (slot->details->forward_list != NULL) {
+		locations = g_list_prepend (locations,
+					    nautilus_bookmark_get_location (slot->details->forward_list->data));
+	}
+
+	nautilus_directory_prefetch (locations);
+	g_list_free_full (locations, g_object_unref);
+}
+
 static void
 view_end_loading_cb (NautilusView       *view,
 		     gboolean            all_files_seen,
@@ -2228,6 +2258,7 @@ view_end_loading_cb (NautilusView       *view,
 						      slot->details->pending_scroll_to);
 		}
 		end_location_change (slot);
+		prefetch_neighbours (slot);
 	}
 
 	if (slot->details->needs_reload) {
@@ -1153,7 +1153,7 @@ nautilus_window_constructed (GObject *self)
 
 	/* Register to menu provider extension signal managing menu updates */
 	g_signal_connect_object (nautilus_signaller_get_current (), "popup-menu-changed",
-			 G_CALLBACK (nautilus_window_load_extension_menus), window, G_CONNECT_SWAPPED);
+			 G_CALLBACK (nautilus_window_invalidate_extension_menus), window, G_CONNECT_SWAPPED);
 	window->details->toolbar = create_toolbar (window);
 	gtk_container_add (GTK_CONTAINER (grid), window->details->toolbar);
 	gtk_widget_set_hexpand (window->details->toolbar, TRUE);
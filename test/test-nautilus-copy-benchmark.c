@@ -0,0 +1,197 @@
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gio/gio.h>
+#include <libnautilus-private/nautilus-local-copy.h>
+
+/* Compares g_file_copy() with nautilus_local_copy_file() on one large
+ * file and on many small ones.
+ *
+ * Usage: test-nautilus-copy-benchmark [dir [large-MB [small-count]]]
+ * The files are created in a temporary folder inside dir, which
+ * defaults to the system temporary directory.
+ */
+
+#define SMALL_FILE_SIZE 4096
+
+typedef gboolean (* CopyFunc) (GFile *source,
+			       GFile *destination,
+			       GFileCopyFlags flags,
+			       GCancellable *cancellable,
+			       GFileProgressCallback progress_callback,
+			       gpointer progress_callback_data,
+			       GError **error);
+
+static void
+write_file (GFile *file,
+	    gsize size)
+{
+	GFileOutputStream *stream;
+	char *buffer;
+	gsize chunk, written;
+	gboolean res;
+
+	buffer = g_malloc (1024 * 1024);
+	memset (buffer, 'n', 1024 * 1024);
+
+	stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, NULL);
+	g_assert (stream != NULL);
+
+	for (written = 0; written < size; written += chunk) {
+		chunk = MIN (size - written, 1024 * 1024);
+		res = g_output_stream_write_all (G_OUTPUT_STREAM (stream), buffer, chunk,
+						 NULL, NULL, NULL);
+		g_assert (res);
+	}
+
+	g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, NULL);
+	g_object_unref (stream);
+	g_free (buffer);
+}
+
+static double
+copy_files (CopyFunc copy,
+	    GList *sources,
+	    GFile *dest_dir)
+{
+	GTimer *timer;
+	GFile *dest;
+	GError *error;
+	GList *l;
+	char *basename;
+	double elapsed;
+
+	timer = g_timer_new ();
+
+	for (l = sources; l != NULL; l = l->next) {
+		basename = g_file_get_basename (l->data);
+		dest = g_file_get_child (dest_dir, basename);
+		g_free (basename);
+
+		error = NULL;
+		if (!copy (l->data, dest, G_FILE_COPY_NOFOLLOW_SYMLINKS,
+			   NULL, NULL, NULL, &error)) {
+			g_printerr ("copy failed: %s\n", error->message);
+			g_error_free (error);
+			g_object_unref (dest);
+			g_timer_destroy (timer);
+			return -1;
+		}
+		g_object_unref (dest);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_timer_destroy (timer);
+
+	return elapsed;
+}
+
+static void
+delete_children (GFile *dir)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+	GFile *child;
+
+	enumerator = g_file_enumerate_children (dir, G_FILE_ATTRIBUTE_STANDARD_NAME,
+						G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+						NULL, NULL);
+	while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
+		child = g_file_get_child (dir, g_file_info_get_name (info));
+		g_file_delete (child, NULL, NULL);
+		g_object_unref (child);
+		g_object_unref (info);
+	}
+	g_object_unref (enumerator);
+}
+
+static gboolean
+run (const char *name,
+     GList *sources,
+     GFile *dest_dir,
+     goffset total_bytes)
+{
+	double plain, fast;
+
+	plain = copy_files (g_file_copy, sources, dest_dir);
+	delete_children (dest_dir);
+	if (plain < 0) {
+		return FALSE;
+	}
+
+	fast = copy_files (nautilus_local_copy_file, sources, dest_dir);
+	delete_children (dest_dir);
+	if (fast < 0) {
+		return FALSE;
+	}
+
+	g_print ("%-6s %6u files  g_file_copy %8.1f MB/s %9.0f files/s   "
+		 "local copy %8.1f MB/s %9.0f files/s\n",
+		 name, g_list_length (sources),
+		 total_bytes / plain / (1024 * 1024), g_list_length (sources) / plain,
+		 total_bytes / fast / (1024 * 1024), g_list_length (sources) / fast);
+
+	return TRUE;
+}
+
+int
+main (int argc, char **argv)
+{
+	const char *parent;
+	char *template, *path;
+	GFile *root, *large_dir, *small_dir, *dest_dir, *file;
+	GList *large, *small;
+	int large_mb, n_small, i;
+	gboolean success;
+
+	parent = argc > 1 ? argv[1] : g_get_tmp_dir ();
+	large_mb = argc > 2 ? atoi (argv[2]) : 512;
+	n_small = argc > 3 ? atoi (argv[3]) : 10000;
+
+	template = g_build_filename (parent, "nautilus-copy-benchmark-XXXXXX", NULL);
+	path = g_mkdtemp (template);
+	g_assert (path != NULL);
+	root = g_file_new_for_path (path);
+
+	large_dir = g_file_get_child (root, "large");
+	small_dir = g_file_get_child (root, "small");
+	dest_dir = g_file_get_child (root, "dest");
+	g_file_make_directory (large_dir, NULL, NULL);
+	g_file_make_directory (small_dir, NULL, NULL);
+	g_file_make_directory (dest_dir, NULL, NULL);
+
+	file = g_file_get_child (large_dir, "large");
+	write_file (file, (gsize) large_mb * 1024 * 1024);
+	large = g_list_prepend (NULL, file);
+
+	small = NULL;
+	for (i = 0; i < n_small; i++) {
+		char *name;
+
+		name = g_strdup_printf ("small-%d", i);
+		file = g_file_get_child (small_dir, name);
+		write_file (file, SMALL_FILE_SIZE);
+		small = g_list_prepend (small, file);
+		g_free (name);
+	}
+
+	success = run ("large", large, dest_dir, (goffset) large_mb * 1024 * 1024) &&
+		run ("small", small, dest_dir, (goffset) n_small * SMALL_FILE_SIZE);
+
+	delete_children (large_dir);
+	delete_children (small_dir);
+	g_file_delete (large_dir, NULL, NULL);
+	g_file_delete (small_dir, NULL, NULL);
+	g_file_delete (dest_dir, NULL, NULL);
+	g_file_delete (root, NULL, NULL);
+
+	g_list_free_full (large, g_object_unref);
+	g_list_free_full (small, g_object_unref);
+	g_object_unref (large_dir);
+	g_object_unref (small_dir);
+	g_object_unref (dest_dir);
+	g_object_unref (root);
+	g_free (template);
+
+	return success ? 0 : 1;
+}
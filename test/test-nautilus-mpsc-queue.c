@@ -0,0 +1,102 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*-
+
+   test-nautilus-mpsc-queue.c: stress test for the multi-producer
+   single-consumer queue
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+  
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+  
+   You should have received a copy of the GNU General Public
+   License along with this program; if not, write to the
+   Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+   Boston, MA 02111-1307, USA.
+*/
+
+#include <glib.h>
+#include <libnautilus-private/nautilus-mpsc-queue.h>
+
+#define N_PRODUCERS 4
+#define ITEMS_PER_PRODUCER 1000000
+
+/* Items carry the producer in the top bits and a sequence number,
+ * starting at 1 so no item is NULL, in the rest.
+ */
+#define PRODUCER_SHIFT 24
+#define ITEM_NEW(producer, seq) GSIZE_TO_POINTER (((gsize) (producer) << PRODUCER_SHIFT) | (seq))
+#define ITEM_PRODUCER(item) (GPOINTER_TO_SIZE (item) >> PRODUCER_SHIFT)
+#define ITEM_SEQ(item) (GPOINTER_TO_SIZE (item) & ((1 << PRODUCER_SHIFT) - 1))
+
+static NautilusMpscQueue *queue;
+
+static gpointer
+producer_thread (gpointer data)
+{
+	gsize producer, seq;
+
+	producer = GPOINTER_TO_SIZE (data);
+	for (seq = 1; seq <= ITEMS_PER_PRODUCER; seq++) {
+		nautilus_mpsc_queue_push (queue, ITEM_NEW (producer, seq));
+	}
+
+	return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+	GThread *threads[N_PRODUCERS];
+	gsize last_seq[N_PRODUCERS];
+	gsize producer, seq, received;
+	gpointer item;
+	GTimer *timer;
+	int i;
+
+	queue = nautilus_mpsc_queue_new ();
+	timer = g_timer_new ();
+
+	for (i = 0; i < N_PRODUCERS; i++) {
+		last_seq[i] = 0;
+		threads[i] = g_thread_new ("producer", producer_thread, GSIZE_TO_POINTER (i));
+	}
+
+	/* Drain while the producers are still running */
+	received = 0;
+	while (received < N_PRODUCERS * ITEMS_PER_PRODUCER) {
+		item = nautilus_mpsc_queue_pop (queue);
+		if (item == NULL) {
+			g_thread_yield ();
+			continue;
+		}
+
+		producer = ITEM_PRODUCER (item);
+		seq = ITEM_SEQ (item);
+
+		g_assert_cmpuint (producer, <, N_PRODUCERS);
+		g_assert_cmpuint (seq, ==, last_seq[producer] + 1);
+		last_seq[producer] = seq;
+		received++;
+	}
+
+	for (i = 0; i < N_PRODUCERS; i++) {
+		g_thread_join (threads[i]);
+		g_assert_cmpuint (last_seq[i], ==, ITEMS_PER_PRODUCER);
+	}
+
+	g_assert (nautilus_mpsc_queue_is_empty (queue));
+	g_assert (nautilus_mpsc_queue_pop (queue) == NULL);
+
+	g_print ("%" G_GSIZE_FORMAT " items from %d producers in order, %.2f s\n",
+		 received, N_PRODUCERS, g_timer_elapsed (timer, NULL));
+
+	g_timer_destroy (timer);
+	nautilus_mpsc_queue_free (queue, NULL);
+
+	return 0;
+}
@@ -0,0 +1,167 @@
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+/* Asserts that the first window of a fresh nautilus instance is drawn
+ * within a time budget, measured from the moment the process is spawned
+ * to the "First window drawn" mark of the profile timeline.
+ *
+ * Usage: dbus-run-session test-nautilus-startup-time [nautilus-binary]
+ * The binary defaults to the one in the build tree.  Needs a display,
+ * no other nautilus on the session bus, and a build with
+ * --enable-profiling.  The budget defaults to 2000ms and can be
+ * changed with NAUTILUS_STARTUP_BUDGET_MSEC.
+ * Exits with 77 (skipped) when the run is not possible.
+ */
+
+#define FIRST_WINDOW_MARK "First window drawn"
+#define DEFAULT_BUDGET_MSEC 2000
+#define TIMEOUT_MSEC 30000
+#define SKIP 77
+
+#define NAUTILUS_BUS_NAME "org.gnome.Nautilus"
+
+/* A running instance would get the window request instead */
+static gboolean
+nautilus_is_running (void)
+{
+	GDBusConnection *connection;
+	GVariant *result;
+	gboolean has_owner;
+
+	connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, NULL);
+	if (connection == NULL) {
+		return FALSE;
+	}
+
+	has_owner = FALSE;
+	result = g_dbus_connection_call_sync (connection,
+					      "org.freedesktop.DBus",
+					      "/org/freedesktop/DBus",
+					      "org.freedesktop.DBus",
+					      "NameHasOwner",
+					      g_variant_new ("(s)", NAUTILUS_BUS_NAME),
+					      G_VARIANT_TYPE ("(b)"),
+					      G_DBUS_CALL_FLAGS_NONE,
+					      -1, NULL, NULL);
+	if (result != NULL) {
+		g_variant_get (result, "(b)", &has_owner);
+		g_variant_unref (result);
+	}
+
+	g_object_unref (connection);
+
+	return has_owner;
+}
+
+static gint64
+find_first_window_mark (const char *timeline)
+{
+	char *contents;
+	char **lines;
+	char **fields;
+	gint64 time;
+	int i;
+
+	if (!g_file_get_contents (timeline, &contents, NULL, NULL)) {
+		return -1;
+	}
+
+	time = -1;
+	lines = g_strsplit (contents, "\n", -1);
+	for (i = 0; lines[i] != NULL && time < 0; i++) {
+		fields = g_strsplit (lines[i], "\t", 4);
+		if (g_strv_length (fields) == 4 &&
+		    strcmp (fields[3], FIRST_WINDOW_MARK) == 0) {
+			time = g_ascii_strtoll (fields[0], NULL, 10);
+		}
+		g_strfreev (fields);
+	}
+
+	g_strfreev (lines);
+	g_free (contents);
+
+	return time;
+}
+
+int
+main (int argc, char **argv)
+{
+	char *child_argv[] = { argc > 1 ? argv[1] : NAUTILUS_BUILT_BINARY, "--no-desktop", NULL };
+	char **envp;
+	char *timeline;
+	const char *budget_env;
+	GError *error;
+	GPid pid;
+	gint64 spawned, drawn;
+	int budget, fd, waited;
+
+#ifndef ENABLE_PROFILING
+	g_print ("SKIP: nautilus was built without profiling\n");
+	return SKIP;
+#endif
+
+	if (g_getenv ("DISPLAY") == NULL && g_getenv ("WAYLAND_DISPLAY") == NULL) {
+		g_print ("SKIP: no display\n");
+		return SKIP;
+	}
+
+	if (nautilus_is_running ()) {
+		g_print ("SKIP: another nautilus owns %s\n", NAUTILUS_BUS_NAME);
+		return SKIP;
+	}
+
+	budget_env = g_getenv ("NAUTILUS_STARTUP_BUDGET_MSEC");
+	budget = budget_env != NULL ? atoi (budget_env) : DEFAULT_BUDGET_MSEC;
+
+	error = NULL;
+	fd = g_file_open_tmp ("nautilus-timeline-XXXXXX", &timeline, &error);
+	if (fd == -1) {
+		g_printerr ("Could not create the timeline file: %s\n", error->message);
+		g_error_free (error);
+		return 1;
+	}
+	close (fd);
+
+	envp = g_get_environ ();
+	envp = g_environ_setenv (envp, "NAUTILUS_PROFILE_TIMELINE", timeline, TRUE);
+
+	spawned = g_get_monotonic_time ();
+	if (!g_spawn_async (NULL, child_argv, envp,
+			    G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+			    NULL, NULL, &pid, &error)) {
+		g_print ("SKIP: could not run %s: %s\n", child_argv[0], error->message);
+		g_error_free (error);
+		g_strfreev (envp);
+		g_unlink (timeline);
+		g_free (timeline);
+		return SKIP;
+	}
+
+	drawn = -1;
+	for (waited = 0; drawn < 0 && waited < TIMEOUT_MSEC; waited += 50) {
+		g_usleep (50 * 1000);
+		drawn = find_first_window_mark (timeline);
+	}
+
+	kill (pid, SIGTERM);
+	g_spawn_close_pid (pid);
+	g_strfreev (envp);
+	g_unlink (timeline);
+	g_free (timeline);
+
+	if (drawn < 0) {
+		g_printerr ("FAIL: no window drawn after %d ms\n", TIMEOUT_MSEC);
+		return 1;
+	}
+
+	g_print ("time to first window: %" G_GINT64_FORMAT " ms (budget %d ms)\n",
+		 (drawn - spawned) / 1000, budget);
+
+	return (drawn - spawned) / 1000 <= budget ? 0 : 1;
+}